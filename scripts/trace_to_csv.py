@@ -0,0 +1,33 @@
+import struct
+import sys
+
+# Binary traces written with --trace=binary are a sequence of blocks, each one a
+# header (magic, record count, hostname) followed by fixed-size records
+HEADER = struct.Struct("=4sI64s")
+RECORD = struct.Struct("=ddii")
+MAGIC = b"TRC1"
+ACTIONS = ["SETUP", "COMPUTATION", "COMMUNICATION", "ORCHESTRATION"]
+
+
+def trace_to_csv(input_file, output_file):
+    with open(input_file, "rb") as infile, open(output_file, "w") as outfile:
+        data = infile.read()
+        offset = 0
+        while offset + HEADER.size <= len(data):
+            magic, record_count, hostname = HEADER.unpack_from(data, offset)
+            if magic != MAGIC:
+                raise ValueError(f"Corrupt trace block at byte {offset}")
+            offset += HEADER.size
+            hostname = hostname.split(b"\0", 1)[0].decode()
+            for _ in range(record_count):
+                start, end, worker_id, action = RECORD.unpack_from(data, offset)
+                offset += RECORD.size
+                outfile.write(f"{ACTIONS[action]},{hostname},{worker_id},{start:.8f},{end:.8f}\n")
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 3:
+        print("Usage: python trace_to_csv.py <input_file> <output_file>")
+        sys.exit(1)
+
+    trace_to_csv(sys.argv[1], sys.argv[2])
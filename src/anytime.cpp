@@ -0,0 +1,223 @@
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <time.h>
+#include <vector>
+
+// Anytime mode (--time-limit, --gap): the branch and bound may stop early and still
+// answer with the best tour so far and a proven lower bound on the optimum. Searches
+// poll the limits every ANYTIME_POLL_NODES nodes; once one is hit, every thread
+// unwinds and the prefixes it cut short stay unfinished. Tours outside the finished
+// prefixes cost at least the root bound of an unfinished one, so the lower bound is
+// the incumbent or the cheapest such root bound, whichever is lower. Every improved
+// tour is printed as soon as it is found.
+
+const int ANYTIME_POLL_NODES = 4096;
+const double ANYTIME_GAP_INTERVAL = 0.25; // Seconds between lower bound updates for --gap
+
+enum AnytimeStatus
+{
+    ANYTIME_RUNNING,
+    ANYTIME_TIME_LIMIT,
+    ANYTIME_GAP
+};
+
+const char *const ANYTIME_STATUS_NAMES[] = {"optimal", "stopped at the time limit", "stopped within the gap"};
+
+struct AnytimeLimits
+{
+    bool enabled = false;
+    double start_time = 0; // CLOCK_MONOTONIC seconds
+    double deadline = 0;   // 0 for none
+    double gap = -1;       // Fraction of the lower bound; < 0 for none
+    std::atomic<int> status;
+    std::atomic<double> next_gap_check;
+
+    // Set by anytime_attach() once the search is set up
+    const PrefixEnumerator *prefixes = nullptr;
+    const std::vector<int> *distances = nullptr;
+    const Incumbent *incumbent = nullptr;
+    LowerBound bound;                        // For root bounds, used in critical(anytime)
+    std::vector<std::atomic<uint64_t>> done; // One bit per finished prefix
+
+    AnytimeLimits() : status(ANYTIME_RUNNING), next_gap_check(0.0) {}
+};
+
+double anytime_clock()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// Call first thing in main, so the time limit covers setup too. A zero time limit
+// and a negative gap are unset.
+void anytime_init(AnytimeLimits &limits, double time_limit, double gap_percent)
+{
+    limits.start_time = anytime_clock();
+    limits.deadline = time_limit > 0 ? limits.start_time + time_limit : 0;
+    limits.gap = gap_percent >= 0 ? gap_percent / 100 : -1;
+    limits.enabled = limits.deadline > 0 || limits.gap >= 0;
+    limits.next_gap_check.store(limits.start_time + ANYTIME_GAP_INTERVAL);
+}
+
+// Prefixes already finished by the checkpoint count as finished here too
+void anytime_attach(AnytimeLimits &limits, const PrefixEnumerator &prefixes, const LowerBound &bound,
+                    const std::vector<int> &distances, const Incumbent &incumbent, const Checkpoint &checkpoint)
+{
+    if (!limits.enabled)
+        return;
+    limits.prefixes = &prefixes;
+    limits.distances = &distances;
+    limits.incumbent = &incumbent;
+    // The one-tree bound is tighter and only computed a few times here, but it assumes
+    // a symmetric matrix
+    BoundKind kind = is_symmetric(distances, prefixes.num_cities) ? BOUND_ONE_TREE : BOUND_MIN_EDGE;
+    if (kind == bound.kind)
+        limits.bound = bound;
+    else
+        init_lower_bound(limits.bound, kind, distances, prefixes.num_cities, prefixes.start_city);
+    limits.bound.closing_above = -1;
+    std::vector<std::atomic<uint64_t>>((prefixes.count + 63) / 64).swap(limits.done);
+    for (long long i = 0; i < prefixes.count; i++)
+    {
+        if (checkpoint_done(checkpoint, i))
+            limits.done[i >> 6].fetch_or((uint64_t)1 << (i & 63), std::memory_order_relaxed);
+    }
+}
+
+inline bool anytime_stopped(const AnytimeLimits &limits)
+{
+    return limits.status.load(std::memory_order_relaxed) != ANYTIME_RUNNING;
+}
+
+// Keeps the first reason given
+void anytime_stop(AnytimeLimits &limits, int status)
+{
+    int running = ANYTIME_RUNNING;
+    limits.status.compare_exchange_strong(running, status, std::memory_order_relaxed);
+}
+
+inline void anytime_mark(AnytimeLimits &limits, long long index)
+{
+    if (limits.enabled)
+        limits.done[index >> 6].fetch_or((uint64_t)1 << (index & 63), std::memory_order_relaxed);
+}
+
+void anytime_mark_range(AnytimeLimits &limits, long long start, long long count)
+{
+    for (long long i = start; i < start + count; i++)
+        anytime_mark(limits, i);
+}
+
+// In the bound order, a prefix that cannot beat the incumbent is dropped without
+// being searched. It counts as finished. Returns true if it was dropped.
+bool drop_hopeless_prefix(const PrefixEnumerator &prefixes, long long index, const Incumbent &incumbent,
+                          Checkpoint &checkpoint, AnytimeLimits &limits)
+{
+    if (!prefix_hopeless(prefixes, index, incumbent_distance(incumbent)))
+        return false;
+    checkpoint_mark(checkpoint, index);
+    anytime_mark(limits, index);
+    return true;
+}
+
+// Proven lower bound on the optimum, given the best distance known
+int anytime_lower_bound(AnytimeLimits &limits, int best_distance)
+{
+    if (limits.prefixes == nullptr)
+        return best_distance;
+    const PrefixEnumerator &prefixes = *limits.prefixes;
+    const int n = prefixes.num_cities;
+    int lower = best_distance;
+#pragma omp critical(anytime)
+    {
+        std::vector<int> prefix(n);
+        std::vector<char> visited(n);
+        for (long long i = 0; i < prefixes.count; i++)
+        {
+            if ((limits.done[i >> 6].load(std::memory_order_relaxed) >> (i & 63)) & 1)
+                continue;
+            int length = prefix_at(prefixes, i, prefix.data());
+            std::fill(visited.begin(), visited.end(), 0);
+            int cost = 0;
+            for (int j = 0; j < length; j++)
+            {
+                visited[prefix[j]] = 1;
+                if (j > 0)
+                    cost += (*limits.distances)[prefix[j - 1] * n + prefix[j]];
+            }
+            if (cost >= lower)
+                continue;
+            if (length < n)
+            {
+                bound_reset(limits.bound, visited);
+                cost += bound_remaining(limits.bound, visited, prefix[length - 1], *limits.distances, lower - cost);
+            }
+            else
+            {
+                cost += (*limits.distances)[prefix[n - 1] * n + prefix[0]];
+            }
+            lower = std::min(lower, cost);
+        }
+    }
+    return lower;
+}
+
+// Checks the deadline and, at most once per ANYTIME_GAP_INTERVAL, the gap. Returns
+// true once the search should stop.
+bool anytime_poll(AnytimeLimits &limits)
+{
+    if (anytime_stopped(limits))
+        return true;
+    double now = anytime_clock();
+    if (limits.deadline > 0 && now >= limits.deadline)
+    {
+        anytime_stop(limits, ANYTIME_TIME_LIMIT);
+        return true;
+    }
+    double next_check = limits.next_gap_check.load(std::memory_order_relaxed);
+    if (limits.gap >= 0 && limits.incumbent != nullptr && now >= next_check &&
+        limits.next_gap_check.compare_exchange_strong(next_check, now + ANYTIME_GAP_INTERVAL,
+                                                      std::memory_order_relaxed))
+    {
+        int best = incumbent_distance(*limits.incumbent);
+        int lower = anytime_lower_bound(limits, best);
+        if (best - lower <= limits.gap * lower)
+        {
+            anytime_stop(limits, ANYTIME_GAP);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Streams an improved tour: "Improved tour: <seconds> <distance> <cities...>"
+void anytime_publish(const AnytimeLimits &limits, int distance, const int *path, int num_cities)
+{
+    if (!limits.enabled)
+        return;
+    double elapsed = anytime_clock() - limits.start_time;
+#pragma omp critical(anytime_output)
+    {
+        printf("Improved tour: %.4f %d", elapsed, distance);
+        for (int i = 0; i < num_cities; i++)
+            printf(" %d", path[i] + 1);
+        printf("\n");
+        fflush(stdout);
+    }
+}
+
+// Final lines of an anytime run, after the minimum distance and path. A heuristic
+// (not `exact`) run has no lower bound to report.
+void anytime_print(AnytimeLimits &limits, int best_distance, bool exact = true)
+{
+    if (!limits.enabled)
+        return;
+    int status = limits.status.load();
+    if (exact)
+        std::cout << "Lower bound: " << anytime_lower_bound(limits, best_distance) << std::endl;
+    std::cout << "Status: " << (exact || status != ANYTIME_RUNNING ? ANYTIME_STATUS_NAMES[status] : "not proven optimal")
+              << std::endl;
+}
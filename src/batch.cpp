@@ -0,0 +1,240 @@
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <time.h>
+#include <vector>
+
+// Batch mode (--batch): the input is a manifest of instance files, one per line, or
+// "-" to stream them on stdin. Each instance is solved in the same long-lived process
+// and reported as one line: "<file> <cities> <distance> <seconds> <tour...>", or
+// "<file> error". Workspaces keep their buffers from one instance to the next.
+
+// Instances at least this large are searched by the whole team (or rank); smaller
+// ones are solved by a single thread, several at a time
+const int BATCH_TEAM_MIN_CITIES = 16;
+
+struct BatchWorkspace
+{
+    std::vector<int> distances;
+    std::vector<int> neighbors;
+    TspInstance instance; // Only for the heuristic solver
+    DominanceMemo memo;   // Allocated on first use, cleared for every instance
+    std::vector<int> path;
+    std::vector<SearchContext> contexts; // Per-thread contexts of a team search
+    std::string filename;
+    int num_cities = 0;
+    bool team = false; // Searched by the whole team rather than one thread
+    bool failed = false;
+    double start_time = 0;
+    LowerBound bound;
+    Incumbent incumbent;
+    PrefixEnumerator prefixes;
+    SearchPrefixFn search_prefix = nullptr;
+};
+
+// Idle workspaces, handed to whichever thread starts the next instance
+struct BatchPool
+{
+    std::vector<std::unique_ptr<BatchWorkspace>> idle;
+};
+
+BatchWorkspace *batch_acquire(BatchPool &pool)
+{
+    BatchWorkspace *workspace = nullptr;
+#pragma omp critical(batch_pool)
+    {
+        if (!pool.idle.empty())
+        {
+            workspace = pool.idle.back().release();
+            pool.idle.pop_back();
+        }
+    }
+    return workspace != nullptr ? workspace : new BatchWorkspace();
+}
+
+void batch_release(BatchPool &pool, BatchWorkspace *workspace)
+{
+#pragma omp critical(batch_pool)
+    pool.idle.emplace_back(workspace);
+}
+
+double batch_clock()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// Points `manifest` at the named file, or at stdin for "-"
+bool open_manifest(const std::string &name, std::ifstream &file, std::istream *&manifest)
+{
+    if (name == "-")
+    {
+        manifest = &std::cin;
+        return true;
+    }
+    file.open(name);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Unable to open manifest " << name << "." << std::endl;
+        return false;
+    }
+    manifest = &file;
+    return true;
+}
+
+// Next instance file name; blank lines and '#' comments are skipped
+bool batch_next(std::istream &manifest, std::string &filename)
+{
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#')
+            continue;
+        size_t end = line.find_last_not_of(" \t\r");
+        filename = line.substr(begin, end - begin + 1);
+        return true;
+    }
+    return false;
+}
+
+// Loads an instance and sets up everything its search needs: initial tour, bound
+// tables, and prefixes for one thread or, if it is large, for a team of `team_size`.
+// Returns false if there is nothing left to search; the Held-Karp and heuristic solvers
+// finish here.
+bool batch_prepare(BatchWorkspace &workspace, const std::string &filename, const SolverOptions &options, int team_size)
+{
+    workspace.filename = filename;
+    workspace.start_time = batch_clock();
+    workspace.prefixes.count = 0;
+    if (options.solver == SOLVER_HEURISTIC)
+    {
+        workspace.num_cities = read_tsplib_instance(filename, workspace.instance, true);
+        workspace.failed = workspace.num_cities == 0 || !heuristic_supported(workspace.instance);
+        if (workspace.failed)
+            return false;
+        AnytimeLimits limits; // Batch runs have no time limit
+        workspace.team = team_size > 1 && workspace.num_cities >= BATCH_TEAM_MIN_CITIES;
+        std::random_device rd;
+        std::pair<std::vector<int>, int> result =
+            heuristic_tour(workspace.instance, 0, 0, 1, workspace.team ? team_size : 1, rd(), limits);
+        init_incumbent(workspace.incumbent, result, workspace.num_cities);
+        return false;
+    }
+
+    workspace.num_cities = read_tsplib_matrix(filename, workspace.distances, solver_cities_supported(options.solver));
+    workspace.failed = workspace.num_cities == 0;
+    if (workspace.failed)
+        return false;
+    const int n = workspace.num_cities;
+
+    if (options.solver == SOLVER_HELD_KARP)
+    {
+        std::pair<std::vector<int>, int> result = held_karp_tsp(workspace.distances, n);
+        workspace.failed = result.first.empty();
+        init_incumbent(workspace.incumbent, result, n);
+        return false;
+    }
+
+    workspace.search_prefix = search_prefix_for(n);
+    workspace.team = team_size > 1 && n >= BATCH_TEAM_MIN_CITIES;
+    std::random_device rd;
+    workspace.failed = workspace.search_prefix == nullptr ||
+                       !init_prefixes(workspace.prefixes, n, 0, std::min(options.prefix_depth, n),
+                                      workspace.team ? team_size : 1, rd(), options.prefix_order == ORDER_BOUND) ||
+                       !order_prefixes_by_bound(workspace.prefixes, workspace.distances);
+    if (workspace.failed)
+        return false;
+    build_neighbor_lists(workspace.distances, n, workspace.neighbors);
+    std::pair<std::vector<int>, int> result = initial_tour(workspace.distances, workspace.neighbors, n, 0, 0, 1);
+    init_incumbent(workspace.incumbent, result, n);
+    init_lower_bound(workspace.bound, options.bound, workspace.distances, n, 0);
+    if (n >= MEMO_MIN_LENGTH + MEMO_MIN_REMAINING)
+    {
+        // Smaller instances never consult the memo, so they skip the clearing too
+        if (workspace.memo.words.empty())
+            init_memo(workspace.memo, options.memo_megabytes);
+        else
+            memo_clear(workspace.memo);
+    }
+    return true;
+}
+
+// Searches every prefix, alone or spread over a new team of threads
+void batch_search(BatchWorkspace &workspace)
+{
+    const PrefixEnumerator &prefixes = workspace.prefixes;
+#pragma omp parallel if (workspace.team)
+    {
+        SearchContext search;
+        init_search(search, workspace.distances, workspace.neighbors, workspace.num_cities, workspace.bound,
+                    workspace.incumbent);
+        attach_memo(search, workspace.memo);
+        int prefix[KERNEL_MAX_CITIES];
+
+#pragma omp for schedule(dynamic)
+        for (long long i = 0; i < prefixes.count; i++)
+        {
+            if (prefix_hopeless(prefixes, i, incumbent_distance(workspace.incumbent)))
+                continue;
+            int prefix_length = prefix_at(prefixes, i, prefix);
+            workspace.search_prefix(search, prefix, prefix_length, nullptr);
+        }
+    }
+}
+
+// The result line of a solved (or failed) instance, without the newline
+std::string batch_result(BatchWorkspace &workspace)
+{
+    if (workspace.failed)
+        return workspace.filename + " error";
+    int distance = incumbent_read(workspace.incumbent, workspace.path);
+    std::string line = workspace.filename + " " + std::to_string(workspace.num_cities) + " " +
+                       std::to_string(distance) + " " + std::to_string(batch_clock() - workspace.start_time);
+    for (int city : workspace.path)
+        line += " " + std::to_string(city + 1);
+    return line;
+}
+
+void batch_print(const std::string &line)
+{
+#pragma omp critical(batch_output)
+    {
+        fputs(line.c_str(), stdout);
+        fputc('\n', stdout);
+        fflush(stdout);
+    }
+}
+
+// Solves one instance start to finish on the calling thread (or its team)
+std::string batch_solve(BatchWorkspace &workspace, const std::string &filename, const SolverOptions &options,
+                        int team_size)
+{
+    if (batch_prepare(workspace, filename, options, team_size))
+    {
+        batch_search(workspace);
+    }
+    return batch_result(workspace);
+}
+
+// Solves the listed instances one after the other on the calling thread, large ones
+// with a team of `team_size` threads
+int batch_run(const SolverOptions &options, int team_size, int worker_id)
+{
+    std::ifstream file;
+    std::istream *manifest;
+    if (!open_manifest(options.input_filename, file, manifest))
+        return 1;
+    BatchWorkspace workspace;
+    std::string filename;
+    while (batch_next(*manifest, filename))
+    {
+        std::string line = batch_solve(workspace, filename, options, team_size);
+        trace_event(TRACE_COMPUTATION, worker_id, workspace.start_time, batch_clock());
+        batch_print(line);
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <atomic>
+#include <functional>
+#include <string>
+#include <omp.h>
+
+// Batch scheduling for the OpenMP builds: one task per instance. Small instances run
+// whole on one thread, several at a time; large ones become prefix tasks, split
+// further like --schedule=tasks, that the rest of the team picks up.
+
+// Searches a large instance with one task per prefix and waits for all of them
+void batch_search_tasks(BatchWorkspace &workspace)
+{
+    const int num_threads = omp_get_num_threads();
+    workspace.contexts.resize(num_threads);
+    for (SearchContext &search : workspace.contexts)
+    {
+        init_search(search, workspace.distances, workspace.neighbors, workspace.num_cities, workspace.bound,
+                    workspace.incumbent);
+        attach_memo(search, workspace.memo);
+    }
+    TaskControl control;
+    init_task_control(control, workspace.num_cities, workspace.prefixes.depth, num_threads);
+    SearchPrefixTasksFn search_prefix_tasks = search_prefix_tasks_for(workspace.num_cities);
+
+    for (long long i = 0; i < workspace.prefixes.count; i++)
+    {
+        if (prefix_hopeless(workspace.prefixes, i, incumbent_distance(workspace.incumbent)))
+            continue;
+        control.pending.fetch_add(1, std::memory_order_relaxed);
+#pragma omp task firstprivate(i) shared(control, workspace)
+        {
+            int prefix[KERNEL_MAX_CITIES];
+            int prefix_length = prefix_at(workspace.prefixes, i, prefix);
+            search_prefix_tasks(workspace.contexts.data(), prefix, prefix_length, control, nullptr);
+            control.pending.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+#pragma omp taskwait
+}
+
+// Solves the instances that `next` yields on the whole team and hands each result
+// line to `report`. Only the thread creating the tasks calls `next`; `report` is
+// called from any thread.
+void batch_run_tasks(const SolverOptions &options, const std::function<bool(std::string &)> &next,
+                     const std::function<void(const std::string &)> &report)
+{
+    BatchPool pool;
+    std::atomic<int> in_flight(0);
+
+#pragma omp parallel
+#pragma omp single
+    {
+        const int num_threads = omp_get_num_threads();
+        std::string filename;
+        while (next(filename))
+        {
+            // With every thread busy the instance runs right here, which also stops this
+            // thread from taking instances faster than the team solves them
+            bool defer = in_flight.fetch_add(1) < num_threads;
+#pragma omp task firstprivate(filename) shared(pool, options, report, in_flight) if (defer)
+            {
+                BatchWorkspace *workspace = batch_acquire(pool);
+                if (batch_prepare(*workspace, filename, options, num_threads))
+                {
+                    if (workspace->team)
+                        batch_search_tasks(*workspace);
+                    else
+                        batch_search(*workspace);
+                }
+                report(batch_result(*workspace));
+                trace_event(TRACE_COMPUTATION, omp_get_thread_num(), workspace->start_time, batch_clock());
+                batch_release(pool, workspace);
+                in_flight.fetch_sub(1);
+            }
+        }
+    }
+}
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include "utils.h"
+
+// Micro-benchmarks of the search kernels, bounds and helpers on generated instances.
+// Instances and prefix orders come from fixed seeds, so two builds can be compared
+// run for run without a cluster: `make bench` or `./benchmark [repetitions] [warmup]`.
+
+const unsigned int BENCH_SEED = 760;
+const int BENCH_DEFAULT_REPETITIONS = 10;
+const int BENCH_DEFAULT_WARMUP = 2;
+
+// Every allocation of the process goes through here and is counted. Kept out of line
+// so GCC does not pair the inlined free() with the library's operator new.
+std::atomic<long long> allocation_count(0);
+
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void *memory = malloc(size > 0 ? size : 1);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+__attribute__((noinline)) void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+double now_seconds()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// What one repetition reports besides its duration
+struct BenchWork
+{
+    long long nodes = 0;
+    long long pruned = 0;
+};
+
+struct BenchResult
+{
+    std::string name;
+    std::vector<double> seconds;
+    long long allocations = 0; // Per repetition
+    BenchWork work;            // Per repetition
+};
+
+double percentile(const std::vector<double> &sorted, double fraction)
+{
+    int index = (int)std::ceil(fraction * sorted.size()) - 1;
+    return sorted[std::max(0, std::min(index, (int)sorted.size() - 1))];
+}
+
+BenchResult run_bench(const std::string &name, int repetitions, int warmup, const std::function<BenchWork()> &body)
+{
+    BenchResult result;
+    result.name = name;
+    for (int r = 0; r < warmup; r++)
+    {
+        body();
+    }
+    long long allocations_before = allocation_count.load();
+    for (int r = 0; r < repetitions; r++)
+    {
+        double start = now_seconds();
+        result.work = body();
+        result.seconds.push_back(now_seconds() - start);
+    }
+    result.allocations = (allocation_count.load() - allocations_before) / repetitions;
+    std::sort(result.seconds.begin(), result.seconds.end());
+    return result;
+}
+
+void print_header()
+{
+    printf("%-28s %10s %10s %10s %10s %12s %7s %10s\n",
+           "benchmark", "min ms", "p50 ms", "p90 ms", "max ms", "nodes/s", "pruned", "allocs");
+}
+
+void print_result(const BenchResult &result)
+{
+    double median = percentile(result.seconds, 0.5);
+    printf("%-28s %10.3f %10.3f %10.3f %10.3f", result.name.c_str(),
+           1e3 * result.seconds.front(), 1e3 * median, 1e3 * percentile(result.seconds, 0.9), 1e3 * result.seconds.back());
+    if (result.work.nodes > 0)
+        printf(" %12.3g %6.1f%%", result.work.nodes / median, 100.0 * result.work.pruned / result.work.nodes);
+    else
+        printf(" %12s %7s", "-", "-");
+    printf(" %10lld\n", result.allocations);
+    fflush(stdout);
+}
+
+// Random points on a 1000 x 1000 square with rounded Euclidean distances
+std::vector<int> generate_instance(int num_cities, unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> coordinate(0, 1000);
+    std::vector<double> x(num_cities), y(num_cities);
+    for (int i = 0; i < num_cities; i++)
+    {
+        x[i] = coordinate(gen);
+        y[i] = coordinate(gen);
+    }
+    std::vector<int> distances(num_cities * num_cities);
+    for (int i = 0; i < num_cities; i++)
+    {
+        for (int j = 0; j < num_cities; j++)
+        {
+            distances[i * num_cities + j] = (int)(std::hypot(x[i] - x[j], y[i] - y[j]) + 0.5);
+        }
+    }
+    return distances;
+}
+
+std::string write_instance(const std::vector<int> &distances, int num_cities)
+{
+    char filename[] = "/tmp/tsp_bench_XXXXXX";
+    int fd = mkstemp(filename);
+    FILE *file = fdopen(fd, "w");
+    fprintf(file, "NAME: bench%d\nTYPE: TSP\nDIMENSION: %d\nEDGE_WEIGHT_TYPE: EXPLICIT\n", num_cities, num_cities);
+    fprintf(file, "EDGE_WEIGHT_FORMAT: LOWER_DIAG_ROW\nEDGE_WEIGHT_SECTION\n");
+    for (int i = 0; i < num_cities; i++)
+    {
+        for (int j = 0; j <= i; j++)
+            fprintf(file, "%d ", distances[i * num_cities + j]);
+        fprintf(file, "\n");
+    }
+    fprintf(file, "EOF\n");
+    fclose(file);
+    return filename;
+}
+
+// The whole branch and bound of the serial driver, with a fixed prefix order
+BenchWork bench_kernel(std::vector<int> &distances, const std::vector<int> &neighbors, int num_cities, BoundKind kind)
+{
+    std::pair<std::vector<int>, int> initial = nearest_neighbor_tsp(distances, num_cities);
+    LowerBound bound;
+    init_lower_bound(bound, kind, distances, num_cities, 0);
+    Incumbent incumbent;
+    init_incumbent(incumbent, initial, num_cities);
+    SearchContext search;
+    init_search(search, distances, neighbors, num_cities, bound, incumbent);
+    PrefixEnumerator prefixes;
+    init_prefixes(prefixes, num_cities, 0, 0, 1, BENCH_SEED);
+    SearchPrefixFn search_prefix = search_prefix_for(num_cities);
+
+    int prefix[KERNEL_MAX_CITIES];
+    for (long long i = 0; i < prefixes.count; i++)
+    {
+        int prefix_length = prefix_at(prefixes, i, prefix);
+        search_prefix(search, prefix, prefix_length, nullptr);
+    }
+
+    BenchWork work;
+    for (int d = 0; d <= KERNEL_MAX_CITIES; d++)
+    {
+        work.nodes += search.nodes[d];
+        work.pruned += search.pruned[d];
+    }
+    return work;
+}
+
+// The original recursive dfs() over create_paths() prefixes, as a baseline
+BenchWork bench_legacy_dfs(std::vector<int> &distances, int num_cities, BoundKind kind)
+{
+    std::pair<std::vector<int>, int> initial = nearest_neighbor_tsp(distances, num_cities);
+    int min_distance = initial.second;
+    std::vector<int> min_path = initial.first;
+    LowerBound bound;
+    init_lower_bound(bound, kind, distances, num_cities, 0);
+    std::vector<std::vector<int>> paths;
+    create_paths(paths, 0, num_cities);
+
+    for (std::vector<int> &path : paths)
+    {
+        std::vector<int> visited(num_cities, 0);
+        int curr_distance = 0;
+        for (int k = 0; k < (int)path.size(); k++)
+        {
+            visited[path[k]] = 1;
+            if (k > 0)
+                curr_distance += distances[path[k - 1] * num_cities + path[k]];
+        }
+        bound_reset(bound, visited);
+        dfs(path, visited, curr_distance, min_distance, min_path, distances, num_cities, bound);
+    }
+    return BenchWork();
+}
+
+int main(int argc, char *argv[])
+{
+    int repetitions = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_REPETITIONS;
+    int warmup = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_WARMUP;
+    if (repetitions < 1 || warmup < 0)
+    {
+        std::cout << "Usage: " << argv[0] << " [repetitions] [warmup]" << std::endl;
+        return 0;
+    }
+    printf("seed %u, %d repetitions after %d warmup runs\n", BENCH_SEED, repetitions, warmup);
+    print_header();
+
+    // Reading and setup helpers, on an instance large enough to time
+    const int large = 1000;
+    std::vector<int> large_distances = generate_instance(large, BENCH_SEED);
+    std::string large_file = write_instance(large_distances, large);
+    print_result(run_bench("read_tsplib_matrix n=1000", repetitions, warmup, [&]() {
+        std::vector<int> loaded;
+        read_tsplib_matrix(large_file, loaded);
+        return BenchWork();
+    }));
+    unlink(large_file.c_str());
+    print_result(run_bench("nearest_neighbor_tsp n=1000", repetitions, warmup, [&]() {
+        nearest_neighbor_tsp(large_distances, large);
+        return BenchWork();
+    }));
+    print_result(run_bench("create_paths n=16", repetitions, warmup, []() {
+        std::vector<std::vector<int>> paths;
+        create_paths(paths, 0, 16);
+        return BenchWork();
+    }));
+
+    // Search kernels
+    const int sizes[] = {12, 14};
+    const BoundKind kinds[] = {BOUND_NONE, BOUND_MIN_EDGE, BOUND_ONE_TREE};
+    const char *const kind_names[] = {"none", "min-edge", "one-tree"};
+    for (int n : sizes)
+    {
+        std::vector<int> distances = generate_instance(n, BENCH_SEED + n);
+        std::vector<int> neighbors;
+        build_neighbor_lists(distances, n, neighbors);
+        print_result(run_bench("initial_tour n=" + std::to_string(n), repetitions, warmup, [&]() {
+            initial_tour(distances, neighbors, n, 0, 0, 1);
+            return BenchWork();
+        }));
+        for (int k = 0; k < 3; k++)
+        {
+            if (kinds[k] == BOUND_NONE && n > 12)
+                continue; // Unpruned search of the larger instance takes too long to repeat
+            std::string suffix = std::string(" n=") + std::to_string(n) + " " + kind_names[k];
+            print_result(run_bench("kernel" + suffix, repetitions, warmup, [&]() {
+                return bench_kernel(distances, neighbors, n, kinds[k]);
+            }));
+            print_result(run_bench("legacy dfs" + suffix, repetitions, warmup, [&]() {
+                return bench_legacy_dfs(distances, n, kinds[k]);
+            }));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+enum BoundKind
+{
+    BOUND_NONE,     // Prune only on the cost of the partial path
+    BOUND_MIN_EDGE, // Add the cheapest edge into every city still to be entered
+    BOUND_ONE_TREE, // Also try a Lagrangian (Held-Karp) spanning tree over the unvisited cities
+    BOUND_AUTO      // One-tree on symmetric matrices, min-edge otherwise
+};
+
+const int ONE_TREE_ITERATIONS = 100;
+
+// Admissible estimate of what it still costs to finish a tour. Precomputed tables are
+// shared read-only; `remaining_*` sums follow the unvisited set as cities are pushed
+// and popped, so every search thread needs its own copy.
+struct LowerBound
+{
+    BoundKind kind = BOUND_NONE;
+    int num_cities = 0;
+    int start_city = 0;
+    int closing_above = -1; // Only cities above this one may close the tour (see orientation_open())
+
+    std::vector<int> min_edge; // Cheapest edge incident to each city
+    int remaining_min_edge = 0; // Sum of min_edge over unvisited cities
+    int max_min_edge = 0;       // Largest entry of min_edge
+    std::vector<int> closing_edge; // closing_edge[k]: cheapest edge into the start city from a city >= k
+
+    std::vector<double> pi;  // Lagrangian node penalties
+    double remaining_pi = 0; // Sum of pi over unvisited cities
+
+    // Scratch space for Prim's algorithm
+    std::vector<int> tree_nodes;
+    std::vector<double> tree_key;
+
+    // Compact transposed matrix (row v holds the edges into v), shared by all copies,
+    // and per-copy 0x00/0xFF city flags for its masked scans
+    std::shared_ptr<const CompactDistances> incoming;
+    std::vector<uint8_t> unvisited_flags;
+    std::vector<uint8_t> predecessor_flags;
+    std::vector<uint8_t> closing_flags;
+};
+
+// Minimum spanning tree of `nodes` under the penalized weights d(i, j) + pi_i + pi_j
+double penalized_mst(LowerBound &bound, const std::vector<int> &distances, int count)
+{
+    const int n = bound.num_cities;
+    std::vector<int> &nodes = bound.tree_nodes;
+    std::vector<double> &key = bound.tree_key;
+
+    // nodes[0..in_tree) are in the tree, key[k] is the cheapest link of nodes[k] into it
+    for (int k = 1; k < count; k++)
+    {
+        key[k] = distances[nodes[0] * n + nodes[k]] + bound.pi[nodes[0]] + bound.pi[nodes[k]];
+    }
+    double total = 0;
+    for (int in_tree = 1; in_tree < count; in_tree++)
+    {
+        int best = in_tree;
+        for (int k = in_tree + 1; k < count; k++)
+        {
+            if (key[k] < key[best])
+                best = k;
+        }
+        std::swap(nodes[in_tree], nodes[best]);
+        std::swap(key[in_tree], key[best]);
+        total += key[in_tree];
+        int added = nodes[in_tree];
+        for (int k = in_tree + 1; k < count; k++)
+        {
+            double weight = distances[added * n + nodes[k]] + bound.pi[added] + bound.pi[nodes[k]];
+            if (weight < key[k])
+                key[k] = weight;
+        }
+    }
+    return total;
+}
+
+// Subgradient ascent on the 1-tree bound of the whole instance to choose penalties
+// that make spanning trees look as much like tours as possible
+void compute_one_tree_penalties(LowerBound &bound, const std::vector<int> &distances)
+{
+    const int n = bound.num_cities;
+    bound.pi.assign(n, 0.0);
+    if (n < 3)
+        return;
+
+    std::vector<double> best_pi(n, 0.0);
+    std::vector<int> parent(n), degree(n);
+    std::vector<double> key(n);
+    std::vector<bool> in_tree(n);
+    double best_value = -1e300;
+    double step = 0;
+
+    for (int iteration = 0; iteration < ONE_TREE_ITERATIONS; iteration++)
+    {
+        // Spanning tree over cities 1..n-1, then the two cheapest edges of city 0
+        std::fill(degree.begin(), degree.end(), 0);
+        std::fill(in_tree.begin(), in_tree.end(), false);
+        std::fill(key.begin(), key.end(), 1e300);
+        double value = 0;
+        key[1] = 0;
+        parent[1] = -1;
+        for (int added = 1; added < n; added++)
+        {
+            int u = -1;
+            for (int v = 1; v < n; v++)
+            {
+                if (!in_tree[v] && (u == -1 || key[v] < key[u]))
+                    u = v;
+            }
+            in_tree[u] = true;
+            value += key[u];
+            if (parent[u] >= 0)
+            {
+                degree[u]++;
+                degree[parent[u]]++;
+            }
+            for (int v = 1; v < n; v++)
+            {
+                double weight = distances[u * n + v] + bound.pi[u] + bound.pi[v];
+                if (!in_tree[v] && weight < key[v])
+                {
+                    key[v] = weight;
+                    parent[v] = u;
+                }
+            }
+        }
+        double first = 1e300, second = 1e300;
+        int first_city = -1, second_city = -1;
+        for (int v = 1; v < n; v++)
+        {
+            double weight = distances[v] + bound.pi[0] + bound.pi[v];
+            if (weight < first)
+            {
+                second = first;
+                second_city = first_city;
+                first = weight;
+                first_city = v;
+            }
+            else if (weight < second)
+            {
+                second = weight;
+                second_city = v;
+            }
+        }
+        value += first + second;
+        degree[0] = 2;
+        degree[first_city]++;
+        degree[second_city]++;
+
+        double pi_sum = 0;
+        int squared_norm = 0;
+        for (int v = 0; v < n; v++)
+        {
+            pi_sum += bound.pi[v];
+            squared_norm += (degree[v] - 2) * (degree[v] - 2);
+        }
+        value -= 2 * pi_sum;
+        if (value > best_value)
+        {
+            best_value = value;
+            best_pi = bound.pi;
+        }
+        if (squared_norm == 0)
+            break; // The 1-tree is a tour, so the bound is tight
+
+        if (iteration == 0)
+            step = 0.01 * value / n;
+        for (int v = 0; v < n; v++)
+        {
+            bound.pi[v] += step * (degree[v] - 2);
+        }
+        step *= 0.95;
+    }
+    bound.pi = best_pi;
+}
+
+bool is_symmetric(const std::vector<int> &distances, int num_cities)
+{
+    for (int i = 0; i < num_cities; i++)
+    {
+        for (int j = i + 1; j < num_cities; j++)
+        {
+            if (distances[i * num_cities + j] != distances[j * num_cities + i])
+                return false;
+        }
+    }
+    return true;
+}
+
+// The one-tree ignores edge directions, so on an asymmetric matrix it is not a lower
+// bound; min-edge is used instead
+void init_lower_bound(LowerBound &bound, BoundKind kind, const std::vector<int> &distances, int num_cities, int start_city)
+{
+    if (kind == BOUND_AUTO)
+    {
+        kind = is_symmetric(distances, num_cities) ? BOUND_ONE_TREE : BOUND_MIN_EDGE;
+    }
+    else if (kind == BOUND_ONE_TREE && !is_symmetric(distances, num_cities))
+    {
+        std::cerr << "Warning: The one-tree bound needs symmetric distances; using min-edge." << std::endl;
+        kind = BOUND_MIN_EDGE;
+    }
+    bound.kind = kind;
+    bound.num_cities = num_cities;
+    bound.start_city = start_city;
+
+    std::shared_ptr<CompactDistances> incoming = std::make_shared<CompactDistances>();
+    build_compact_distances(*incoming, distances, num_cities, true);
+    bound.incoming = incoming;
+    int stride = compact_stride(*incoming);
+    bound.unvisited_flags.assign(stride, 0);
+    bound.predecessor_flags.assign(stride, 0);
+    bound.closing_flags.assign(stride, 0);
+
+    // Cheapest edge into each city: a row minimum of the transposed matrix
+    std::vector<uint8_t> all_cities(stride, 0);
+    std::fill(all_cities.begin(), all_cities.begin() + num_cities, 0xFF);
+    bound.min_edge.assign(num_cities, 0);
+    for (int i = 0; i < num_cities; i++)
+    {
+        bound.min_edge[i] = num_cities > 1 ? compact_row_min(*incoming, i, all_cities.data()) : 0;
+    }
+    bound.max_min_edge = num_cities > 0 ? *std::max_element(bound.min_edge.begin(), bound.min_edge.end()) : 0;
+    bound.closing_edge.assign(num_cities + 1, 0);
+    for (int k = num_cities - 1; k >= 0; k--)
+    {
+        int edge = k == start_city ? INT_MAX : distances[k * num_cities + start_city];
+        bound.closing_edge[k] = std::min(edge, k + 1 < num_cities ? bound.closing_edge[k + 1] : INT_MAX);
+    }
+    for (int k = 0; k <= num_cities; k++)
+    {
+        if (bound.closing_edge[k] == INT_MAX)
+            bound.closing_edge[k] = 0; // No such city; the search never gets there
+    }
+
+    bound.pi.assign(num_cities, 0.0);
+    if (kind == BOUND_ONE_TREE)
+    {
+        compute_one_tree_penalties(bound, distances);
+    }
+    bound.tree_nodes.resize(num_cities);
+    bound.tree_key.resize(num_cities);
+}
+
+// Recomputes the incremental sums for the unvisited set of a fresh prefix
+template <typename Visited>
+void bound_reset(LowerBound &bound, const Visited &visited)
+{
+    bound.remaining_min_edge = 0;
+    bound.remaining_pi = 0;
+    for (int i = 0; i < bound.num_cities; i++)
+    {
+        if (!visited[i])
+        {
+            bound.remaining_min_edge += bound.min_edge[i];
+            bound.remaining_pi += bound.pi[i];
+        }
+    }
+}
+
+inline void bound_visit(LowerBound &bound, int city)
+{
+    bound.remaining_min_edge -= bound.min_edge[city];
+    bound.remaining_pi -= bound.pi[city];
+}
+
+inline void bound_unvisit(LowerBound &bound, int city)
+{
+    bound.remaining_min_edge += bound.min_edge[city];
+    bound.remaining_pi += bound.pi[city];
+}
+
+// Lower bound on the rest of the tour that holds whichever unvisited city comes next,
+// so children can be cut off in bulk once the path cost plus this floor is too high
+inline int bound_floor(const LowerBound &bound)
+{
+    if (bound.kind == BOUND_NONE)
+        return 0;
+    return bound.remaining_min_edge - bound.max_min_edge + bound.closing_edge[bound.closing_above + 1];
+}
+
+// Lower bound on the cost of the rest of the tour: a path from `last` through every
+// unvisited city and back to the start city. Returns early once it reaches `cutoff`.
+template <typename Visited>
+int bound_remaining(LowerBound &bound, const Visited &visited, int last, const std::vector<int> &distances, int cutoff)
+{
+    if (bound.kind == BOUND_NONE)
+        return 0;
+
+    // Every unvisited city and the start city still need one incoming edge
+    int estimate = bound.remaining_min_edge + bound.closing_edge[bound.closing_above + 1];
+    if (bound.kind == BOUND_MIN_EDGE || estimate >= cutoff)
+        return estimate;
+
+    if (last == bound.start_city)
+        return estimate;
+
+    // The rest of the tour is a spanning tree of the unvisited cities plus both ends
+    int count = 0;
+    bound.tree_nodes[count++] = last;
+    bound.tree_nodes[count++] = bound.start_city;
+    for (int i = 0; i < bound.num_cities; i++)
+    {
+        uint8_t flag = visited[i] ? 0 : 0xFF;
+        bound.unvisited_flags[i] = flag;
+        bound.predecessor_flags[i] = flag;
+        bound.closing_flags[i] = i > bound.closing_above ? flag : 0;
+        if (flag)
+            bound.tree_nodes[count++] = i;
+    }
+    if (count <= 2)
+        return estimate;
+
+    // Cheaper than the tree and often enough: each unvisited city is entered from
+    // another unvisited city or from `last`, and the start city from an unvisited one
+    // that may close the tour
+    bound.predecessor_flags[last] = 0xFF;
+    int entering = compact_row_minima_sum(*bound.incoming, bound.unvisited_flags.data(), bound.predecessor_flags.data());
+    int closing = compact_row_min(*bound.incoming, bound.start_city, bound.closing_flags.data());
+    if (entering != INT_MAX && closing != INT_MAX)
+        estimate = std::max(estimate, entering + closing);
+    if (estimate >= cutoff)
+        return estimate;
+    double tree = penalized_mst(bound, distances, count) - 2 * bound.remaining_pi - bound.pi[last] - bound.pi[bound.start_city];
+    int one_tree = (int)std::ceil(tree - 1e-6);
+    return std::max(estimate, one_tree);
+}
@@ -0,0 +1,406 @@
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// Checkpoints of a branch and bound run: which prefixes are finished, plus the best
+// tour. A prefix is marked only after its whole subtree has been searched and its
+// tours offered, so a restart can skip every marked prefix and lose nothing. A run
+// stopped by its time limit also saves the search stacks of the prefixes it was in,
+// so the next job continues them and even a prefix longer than one job's budget
+// finishes over a chain of jobs. The file is written to a temporary name and
+// renamed, so a job killed mid-write keeps the previous checkpoint.
+
+const char CHECKPOINT_MAGIC[8] = {'T', 'S', 'P', 'C', 'K', 'P', 'T', '2'};
+const double CHECKPOINT_DEFAULT_INTERVAL = 60.0;
+
+struct CheckpointHeader
+{
+    char magic[8];
+    int32_t num_cities;
+    int32_t start_city;
+    int32_t depth;
+    int32_t best_distance;
+    int64_t count; // Prefix order the completed set refers to
+    int64_t multiplier;
+    int64_t offset;
+    uint64_t fingerprint; // Of the distance matrix, to reject another instance
+    int64_t stack_words;  // Length of the saved stacks that follow the completed set
+};
+
+// A SearchStack of a stopped prefix search, independent of the kernel instantiation.
+// Bit k of an untried mask stands for the k-th nearest neighbor, which the matrix
+// fingerprint pins down.
+struct SavedStack
+{
+    int base;
+    int depth;
+    std::vector<int> path;         // The first `depth` cities
+    std::vector<int> cost;         // Distance so far, for path lengths base..depth
+    std::vector<uint64_t> untried; // Children not tried yet, for path lengths base..depth
+};
+
+struct Checkpoint
+{
+    bool enabled = false;
+    bool writer = false; // Only the process that owns the file writes it (rank 0)
+    bool resumed = false;
+    std::string filename;
+    double interval = CHECKPOINT_DEFAULT_INTERVAL;
+    std::atomic<double> next_save;
+    uint64_t fingerprint = 0;
+    PrefixEnumerator prefixes;
+    std::vector<std::atomic<uint64_t>> done; // One bit per prefix index
+    int best_distance = INT_MAX;             // Best tour known to the checkpoint
+    std::vector<int> best_path;
+    // Stacks left in unfinished prefixes, by prefix index: by the job that wrote the
+    // file (read-only during the search), and by searches this process stopped, in
+    // critical(checkpoint). An empty list there marks a prefix that finished anyway.
+    std::map<long long, std::vector<SavedStack>> saved_stacks;
+    std::map<long long, std::vector<SavedStack>> stopped_stacks;
+
+    Checkpoint() : next_save(0.0) {}
+};
+
+double checkpoint_clock()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// FNV-1a over the matrix entries
+uint64_t matrix_fingerprint(const std::vector<int> &distances)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (int distance : distances)
+    {
+        hash ^= (uint32_t)distance;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Appends saved stacks as 64-bit words: the prefix index and stack count, then per
+// stack its base, depth, path and the cost and untried entries
+void pack_stacks(long long index, const std::vector<SavedStack> &stacks, std::vector<int64_t> &words)
+{
+    words.push_back(index);
+    words.push_back(stacks.size());
+    for (const SavedStack &stack : stacks)
+    {
+        words.push_back(stack.base);
+        words.push_back(stack.depth);
+        words.insert(words.end(), stack.path.begin(), stack.path.end());
+        words.insert(words.end(), stack.cost.begin(), stack.cost.end());
+        words.insert(words.end(), stack.untried.begin(), stack.untried.end());
+    }
+}
+
+// Calls `found(index, stacks)` for every prefix in packed words. Returns false if the
+// words are malformed.
+template <typename Found>
+bool unpack_stacks(const std::vector<int64_t> &words, const PrefixEnumerator &prefixes, Found found)
+{
+    const int n = prefixes.num_cities;
+    size_t w = 0;
+    while (w < words.size())
+    {
+        if (words.size() - w < 2 || words[w] < 0 || words[w] >= prefixes.count || words[w + 1] < 0 ||
+            words[w + 1] > (int64_t)(words.size() - w) / 2)
+            return false;
+        long long index = words[w];
+        std::vector<SavedStack> stacks(words[w + 1]);
+        w += 2;
+        for (SavedStack &stack : stacks)
+        {
+            if (words.size() - w < 2)
+                return false;
+            stack.base = words[w];
+            stack.depth = words[w + 1];
+            w += 2;
+            if (stack.base < prefixes.depth || stack.depth < stack.base || stack.depth >= n ||
+                words.size() - w < (size_t)(stack.depth + 2 * (stack.depth - stack.base + 1)))
+                return false;
+            stack.path.assign(words.begin() + w, words.begin() + w + stack.depth);
+            w += stack.depth;
+            stack.cost.assign(words.begin() + w, words.begin() + w + stack.depth - stack.base + 1);
+            w += stack.depth - stack.base + 1;
+            stack.untried.assign(words.begin() + w, words.begin() + w + stack.depth - stack.base + 1);
+            w += stack.depth - stack.base + 1;
+            for (int city : stack.path)
+            {
+                if (city < 0 || city >= n)
+                    return false;
+            }
+        }
+        found(index, stacks);
+    }
+    return true;
+}
+
+void checkpoint_resize(Checkpoint &checkpoint, long long count)
+{
+    std::vector<std::atomic<uint64_t>> done((count + 63) / 64);
+    for (std::atomic<uint64_t> &word : done)
+        word.store(0, std::memory_order_relaxed);
+    checkpoint.done.swap(done);
+}
+
+// Reads an existing checkpoint file, if any. Returns false if the file exists but
+// is unreadable or belongs to another instance.
+bool checkpoint_open(Checkpoint &checkpoint, const std::string &filename, double interval,
+                     const std::vector<int> &distances, int num_cities)
+{
+    checkpoint.enabled = !filename.empty();
+    checkpoint.writer = checkpoint.enabled;
+    if (!checkpoint.enabled)
+        return true;
+    checkpoint.filename = filename;
+    checkpoint.interval = interval;
+    checkpoint.next_save.store(checkpoint_clock() + interval);
+    checkpoint.fingerprint = matrix_fingerprint(distances);
+
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (file == nullptr)
+        return true; // First job of the chain
+
+    CheckpointHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0;
+    if (valid && (header.num_cities != num_cities || header.fingerprint != checkpoint.fingerprint))
+    {
+        std::cerr << "Error: Checkpoint " << filename << " belongs to another instance." << std::endl;
+        fclose(file);
+        return false;
+    }
+    valid = valid && header.depth >= 1 && header.depth <= num_cities &&
+            header.count == prefix_count(num_cities, header.depth);
+    if (valid)
+    {
+        checkpoint.prefixes.num_cities = num_cities;
+        checkpoint.prefixes.start_city = header.start_city;
+        checkpoint.prefixes.depth = header.depth;
+        checkpoint.prefixes.count = header.count;
+        checkpoint.prefixes.multiplier = header.multiplier;
+        checkpoint.prefixes.offset = header.offset;
+        checkpoint.best_distance = header.best_distance;
+        checkpoint.best_path.resize(num_cities);
+        checkpoint_resize(checkpoint, header.count);
+        std::vector<uint64_t> words(checkpoint.done.size());
+        std::vector<int64_t> stack_words(header.stack_words >= 0 ? header.stack_words : 0);
+        valid = header.stack_words >= 0 &&
+                fread(checkpoint.best_path.data(), sizeof(int), num_cities, file) == (size_t)num_cities &&
+                fread(words.data(), sizeof(uint64_t), words.size(), file) == words.size() &&
+                fread(stack_words.data(), sizeof(int64_t), stack_words.size(), file) == stack_words.size() &&
+                unpack_stacks(stack_words, checkpoint.prefixes,
+                              [&](long long index, std::vector<SavedStack> &stacks) {
+                                  checkpoint.saved_stacks[index].swap(stacks);
+                              });
+        for (size_t w = 0; w < words.size(); w++)
+            checkpoint.done[w].store(words[w], std::memory_order_relaxed);
+    }
+    fclose(file);
+    if (!valid)
+    {
+        std::cerr << "Error: Unable to read checkpoint " << filename << "." << std::endl;
+        return false;
+    }
+    checkpoint.resumed = true;
+    return true;
+}
+
+long long checkpoint_remaining(const Checkpoint &checkpoint)
+{
+    if (!checkpoint.enabled)
+        return -1;
+    long long finished = 0;
+    for (const std::atomic<uint64_t> &word : checkpoint.done)
+        finished += __builtin_popcountll(word.load(std::memory_order_relaxed));
+    return checkpoint.prefixes.count - finished;
+}
+
+// On a fresh run the completed set follows `prefixes`; on a resumed one `prefixes`
+// is replaced by the order stored in the checkpoint. An explicit --depth must match it.
+bool checkpoint_attach(Checkpoint &checkpoint, PrefixEnumerator &prefixes, int requested_depth)
+{
+    if (!checkpoint.enabled)
+        return true;
+    if (!checkpoint.resumed)
+    {
+        checkpoint.prefixes = prefixes;
+        checkpoint_resize(checkpoint, prefixes.count);
+        return true;
+    }
+    if (requested_depth > 0 && requested_depth != checkpoint.prefixes.depth)
+    {
+        std::cerr << "Error: Checkpoint " << checkpoint.filename << " was written with --depth="
+                  << checkpoint.prefixes.depth << "." << std::endl;
+        return false;
+    }
+    prefixes = checkpoint.prefixes;
+    std::cout << "Resuming from " << checkpoint.filename << ": " << checkpoint_remaining(checkpoint) << " of "
+              << prefixes.count << " prefixes left";
+    if (!checkpoint.saved_stacks.empty())
+        std::cout << ", " << checkpoint.saved_stacks.size() << " of them part searched";
+    std::cout << std::endl;
+    return true;
+}
+
+// Starts from the checkpointed tour if it beats the freshly computed one
+void checkpoint_seed_tour(const Checkpoint &checkpoint, std::pair<std::vector<int>, int> &tour)
+{
+    if (checkpoint.resumed && checkpoint.best_distance < tour.second)
+    {
+        tour.first = checkpoint.best_path;
+        tour.second = checkpoint.best_distance;
+    }
+}
+
+inline bool checkpoint_done(const Checkpoint &checkpoint, long long index)
+{
+    return checkpoint.enabled &&
+           (checkpoint.done[index >> 6].load(std::memory_order_relaxed) >> (index & 63)) & 1;
+}
+
+// Release order: a writer that sees the bit also sees the tours offered before it
+inline void checkpoint_mark(Checkpoint &checkpoint, long long index)
+{
+    if (checkpoint.enabled)
+        checkpoint.done[index >> 6].fetch_or((uint64_t)1 << (index & 63), std::memory_order_release);
+}
+
+void checkpoint_mark_range(Checkpoint &checkpoint, long long start, long long count)
+{
+    for (long long i = start; i < start + count; i++)
+        checkpoint_mark(checkpoint, i);
+}
+
+// The stacks an earlier job left in prefix `index`, or none to search it afresh
+void checkpoint_stacks(const Checkpoint &checkpoint, long long index, std::vector<SavedStack> &stacks)
+{
+    auto entry = checkpoint.saved_stacks.find(index);
+    if (entry != checkpoint.saved_stacks.end())
+        stacks = entry->second;
+    else
+        stacks.clear();
+}
+
+// Records where a stopped search left prefix `index`: the stacks still to search, or
+// none if it finished after all
+void checkpoint_stop(Checkpoint &checkpoint, long long index, std::vector<SavedStack> &stacks)
+{
+    if (stacks.empty())
+        checkpoint_mark(checkpoint, index);
+#pragma omp critical(checkpoint)
+    checkpoint.stopped_stacks[index].swap(stacks);
+}
+
+// Records a tour found elsewhere (another rank) so the next checkpoint can store it
+void checkpoint_offer(Checkpoint &checkpoint, int distance, const int *path, int num_cities)
+{
+    if (!checkpoint.writer)
+        return;
+#pragma omp critical(checkpoint)
+    {
+        if (distance < checkpoint.best_distance)
+        {
+            checkpoint.best_distance = distance;
+            checkpoint.best_path.assign(path, path + num_cities);
+        }
+    }
+}
+
+// Caller holds critical(checkpoint). The completed set is copied before the
+// incumbent is read, so the stored tour covers every prefix the file marks done.
+bool checkpoint_write_locked(Checkpoint &checkpoint, const Incumbent &incumbent)
+{
+    std::vector<uint64_t> words(checkpoint.done.size());
+    for (size_t w = 0; w < words.size(); w++)
+        words[w] = checkpoint.done[w].load(std::memory_order_acquire);
+    // Stacks of this run's stopped searches replace those the file was read with
+    std::vector<int64_t> stack_words;
+    std::map<long long, std::vector<SavedStack>> stacks = checkpoint.stopped_stacks;
+    stacks.insert(checkpoint.saved_stacks.begin(), checkpoint.saved_stacks.end());
+    for (const auto &entry : stacks)
+    {
+        if (!entry.second.empty() && !((words[entry.first >> 6] >> (entry.first & 63)) & 1))
+            pack_stacks(entry.first, entry.second, stack_words);
+    }
+    std::vector<int> path;
+    int distance = incumbent_read(incumbent, path);
+    if (distance < checkpoint.best_distance)
+    {
+        checkpoint.best_distance = distance;
+        checkpoint.best_path = path;
+    }
+
+    CheckpointHeader header;
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.num_cities = checkpoint.prefixes.num_cities;
+    header.start_city = checkpoint.prefixes.start_city;
+    header.depth = checkpoint.prefixes.depth;
+    header.best_distance = checkpoint.best_distance;
+    header.count = checkpoint.prefixes.count;
+    header.multiplier = checkpoint.prefixes.multiplier;
+    header.offset = checkpoint.prefixes.offset;
+    header.fingerprint = checkpoint.fingerprint;
+    header.stack_words = stack_words.size();
+    checkpoint.best_path.resize(header.num_cities, 0);
+
+    std::string temporary = checkpoint.filename + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    bool written = file != nullptr &&
+                   fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(checkpoint.best_path.data(), sizeof(int), header.num_cities, file) == (size_t)header.num_cities &&
+                   fwrite(words.data(), sizeof(uint64_t), words.size(), file) == words.size() &&
+                   fwrite(stack_words.data(), sizeof(int64_t), stack_words.size(), file) == stack_words.size();
+    if (file != nullptr)
+    {
+        written = fflush(file) == 0 && fsync(fileno(file)) == 0 && written;
+        written = fclose(file) == 0 && written;
+    }
+    if (!written || rename(temporary.c_str(), checkpoint.filename.c_str()) != 0)
+    {
+        std::cerr << "Error: Unable to write checkpoint " << checkpoint.filename << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Cheap enough to call after every prefix: writes only once the interval has
+// elapsed, and only one thread of the process does so
+void checkpoint_tick(Checkpoint &checkpoint, const Incumbent &incumbent)
+{
+    if (!checkpoint.writer || checkpoint_clock() < checkpoint.next_save.load(std::memory_order_relaxed))
+        return;
+#pragma omp critical(checkpoint)
+    {
+        double now = checkpoint_clock();
+        if (now >= checkpoint.next_save.load(std::memory_order_relaxed))
+        {
+            checkpoint_write_locked(checkpoint, incumbent);
+            checkpoint.next_save.store(now + checkpoint.interval, std::memory_order_relaxed);
+        }
+    }
+}
+
+// The search is over. If it was `complete`, every prefix is done and the incumbent is
+// the optimum, so a later job resuming from this file skips straight to the result;
+// a search stopped early saves the prefixes it finished and the stacks it stopped in.
+void checkpoint_finish(Checkpoint &checkpoint, const Incumbent &incumbent, bool complete = true)
+{
+    if (!checkpoint.writer)
+        return;
+    if (complete)
+        checkpoint_mark_range(checkpoint, 0, checkpoint.prefixes.count);
+#pragma omp critical(checkpoint)
+    checkpoint_write_locked(checkpoint, incumbent);
+}
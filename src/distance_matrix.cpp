@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#define DISTANCE_SIMD_DISPATCH
+#include <immintrin.h>
+#endif
+
+// Compact copy of the distance matrix for the scans done by the bound and heuristic
+// code. Weights are stored in the narrowest type that holds the largest edge, so a
+// 64-city matrix takes 4 KB as uint8_t instead of 16 KB, and rows are padded to whole
+// cache lines. The largest value of the type means "no edge": it fills the diagonal
+// and the padding, so row minima never pick them up.
+
+const int DISTANCE_ROW_ALIGNMENT = 64; // Bytes
+
+enum DistanceWidth
+{
+    DISTANCE_UINT8,
+    DISTANCE_UINT16,
+    DISTANCE_INT32
+};
+
+template <typename Weight>
+struct DistanceMatrix
+{
+    static const Weight NO_EDGE = std::numeric_limits<Weight>::max();
+
+    int num_cities = 0;
+    int stride = 0; // Row length in elements, a whole number of cache lines
+    std::unique_ptr<Weight, decltype(&free)> data{nullptr, &free};
+
+    const Weight *row(int i) const { return data.get() + (size_t)i * stride; }
+};
+
+template <typename Weight>
+const Weight DistanceMatrix<Weight>::NO_EDGE;
+
+// Matrix in the width picked by choose_distance_width(); only that member is filled
+struct CompactDistances
+{
+    DistanceWidth width = DISTANCE_INT32;
+    DistanceMatrix<uint8_t> narrow;
+    DistanceMatrix<uint16_t> medium;
+    DistanceMatrix<int32_t> wide;
+};
+
+DistanceWidth choose_distance_width(const std::vector<int> &distances, int num_cities)
+{
+    int smallest = 0, largest = 0;
+    for (int i = 0; i < num_cities; i++)
+    {
+        for (int j = 0; j < num_cities; j++)
+        {
+            if (i == j)
+                continue;
+            smallest = std::min(smallest, distances[(size_t)i * num_cities + j]);
+            largest = std::max(largest, distances[(size_t)i * num_cities + j]);
+        }
+    }
+    if (smallest >= 0 && largest < DistanceMatrix<uint8_t>::NO_EDGE)
+        return DISTANCE_UINT8;
+    if (smallest >= 0 && largest < DistanceMatrix<uint16_t>::NO_EDGE)
+        return DISTANCE_UINT16;
+    return DISTANCE_INT32;
+}
+
+// Copies `distances`, transposed if requested (row v then holds the edges into v)
+template <typename Weight>
+void build_distance_matrix(DistanceMatrix<Weight> &matrix, const std::vector<int> &distances, int num_cities, bool transpose)
+{
+    const int per_line = DISTANCE_ROW_ALIGNMENT / sizeof(Weight);
+    matrix.num_cities = num_cities;
+    matrix.stride = (num_cities + per_line - 1) / per_line * per_line;
+    void *memory = nullptr;
+    size_t bytes = (size_t)num_cities * matrix.stride * sizeof(Weight);
+    if (posix_memalign(&memory, DISTANCE_ROW_ALIGNMENT, bytes > 0 ? bytes : DISTANCE_ROW_ALIGNMENT) != 0)
+        throw std::bad_alloc();
+    matrix.data.reset(static_cast<Weight *>(memory));
+
+    for (int i = 0; i < num_cities; i++)
+    {
+        Weight *row = matrix.data.get() + (size_t)i * matrix.stride;
+        for (int j = 0; j < matrix.stride; j++)
+        {
+            if (j >= num_cities || j == i)
+                row[j] = DistanceMatrix<Weight>::NO_EDGE;
+            else
+                row[j] = (Weight)(transpose ? distances[(size_t)j * num_cities + i] : distances[(size_t)i * num_cities + j]);
+        }
+    }
+}
+
+void build_compact_distances(CompactDistances &compact, const std::vector<int> &distances, int num_cities, bool transpose)
+{
+    compact.width = choose_distance_width(distances, num_cities);
+    switch (compact.width)
+    {
+    case DISTANCE_UINT8:
+        build_distance_matrix(compact.narrow, distances, num_cities, transpose);
+        break;
+    case DISTANCE_UINT16:
+        build_distance_matrix(compact.medium, distances, num_cities, transpose);
+        break;
+    default:
+        build_distance_matrix(compact.wide, distances, num_cities, transpose);
+        break;
+    }
+}
+
+// Smallest entry of `row` among the columns whose byte in `allowed` is 0xFF (0 elsewhere).
+// `row` and `allowed` must cover the padded stride. Returns NO_EDGE if none is allowed.
+// The vector versions below handle whole vectors and leave the rest of the row here.
+template <typename Weight>
+inline Weight masked_row_min_scalar(const Weight *row, const uint8_t *allowed, int from, int stride, Weight best)
+{
+    for (int j = from; j < stride; j++)
+    {
+        if (allowed[j] && row[j] < best)
+            best = row[j];
+    }
+    return best;
+}
+
+#if defined(DISTANCE_SIMD_DISPATCH)
+// The binaries are built for the baseline instruction set; these are compiled for
+// AVX2 or SSE4.1 on their own and only called once the CPU is known to have it
+enum SimdLevel
+{
+    SIMD_NONE,
+    SIMD_SSE4_1,
+    SIMD_AVX2
+};
+
+SimdLevel detect_simd_level()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return SIMD_SSE4_1;
+    return SIMD_NONE;
+}
+
+const SimdLevel SIMD_LEVEL = detect_simd_level();
+
+__attribute__((target("avx2"))) uint8_t masked_row_min_avx2(const uint8_t *row, const uint8_t *allowed, int stride)
+{
+    int j = 0;
+    __m256i lanes = _mm256_set1_epi8((char)0xFF);
+    for (; j + 32 <= stride; j += 32)
+    {
+        __m256i weights = _mm256_load_si256((const __m256i *)(row + j));
+        __m256i mask = _mm256_loadu_si256((const __m256i *)(allowed + j));
+        lanes = _mm256_min_epu8(lanes, _mm256_or_si256(weights, _mm256_xor_si256(mask, _mm256_set1_epi8((char)0xFF))));
+    }
+    __m128i half = _mm_min_epu8(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1));
+    // There is no horizontal byte minimum; minpos works on zero-extended 16-bit lanes
+    __m128i low = _mm_minpos_epu16(_mm_cvtepu8_epi16(half));
+    __m128i high = _mm_minpos_epu16(_mm_cvtepu8_epi16(_mm_srli_si128(half, 8)));
+    uint8_t best = (uint8_t)std::min(_mm_extract_epi16(low, 0), _mm_extract_epi16(high, 0));
+    return masked_row_min_scalar(row, allowed, j, stride, best);
+}
+
+__attribute__((target("sse4.1"))) uint8_t masked_row_min_sse4_1(const uint8_t *row, const uint8_t *allowed, int stride)
+{
+    int j = 0;
+    __m128i lanes = _mm_set1_epi8((char)0xFF);
+    for (; j + 16 <= stride; j += 16)
+    {
+        __m128i weights = _mm_load_si128((const __m128i *)(row + j));
+        __m128i mask = _mm_loadu_si128((const __m128i *)(allowed + j));
+        lanes = _mm_min_epu8(lanes, _mm_or_si128(weights, _mm_xor_si128(mask, _mm_set1_epi8((char)0xFF))));
+    }
+    __m128i low = _mm_minpos_epu16(_mm_cvtepu8_epi16(lanes));
+    __m128i high = _mm_minpos_epu16(_mm_cvtepu8_epi16(_mm_srli_si128(lanes, 8)));
+    uint8_t best = (uint8_t)std::min(_mm_extract_epi16(low, 0), _mm_extract_epi16(high, 0));
+    return masked_row_min_scalar(row, allowed, j, stride, best);
+}
+
+__attribute__((target("avx2"))) uint16_t masked_row_min_avx2(const uint16_t *row, const uint8_t *allowed, int stride)
+{
+    int j = 0;
+    __m256i lanes = _mm256_set1_epi16((short)0xFFFF);
+    for (; j + 16 <= stride; j += 16)
+    {
+        __m256i weights = _mm256_load_si256((const __m256i *)(row + j));
+        __m256i mask = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(allowed + j)));
+        lanes = _mm256_min_epu16(lanes, _mm256_or_si256(weights, _mm256_xor_si256(mask, _mm256_set1_epi16((short)0xFFFF))));
+    }
+    __m128i half = _mm_min_epu16(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1));
+    uint16_t best = (uint16_t)_mm_extract_epi16(_mm_minpos_epu16(half), 0);
+    return masked_row_min_scalar(row, allowed, j, stride, best);
+}
+
+__attribute__((target("sse4.1"))) uint16_t masked_row_min_sse4_1(const uint16_t *row, const uint8_t *allowed, int stride)
+{
+    int j = 0;
+    __m128i lanes = _mm_set1_epi16((short)0xFFFF);
+    for (; j + 8 <= stride; j += 8)
+    {
+        __m128i weights = _mm_load_si128((const __m128i *)(row + j));
+        __m128i mask = _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i *)(allowed + j)));
+        lanes = _mm_min_epu16(lanes, _mm_or_si128(weights, _mm_xor_si128(mask, _mm_set1_epi16((short)0xFFFF))));
+    }
+    uint16_t best = (uint16_t)_mm_extract_epi16(_mm_minpos_epu16(lanes), 0);
+    return masked_row_min_scalar(row, allowed, j, stride, best);
+}
+
+__attribute__((target("avx2"))) int32_t masked_row_min_avx2(const int32_t *row, const uint8_t *allowed, int stride)
+{
+    int j = 0;
+    __m256i no_edge = _mm256_set1_epi32(INT_MAX);
+    __m256i lanes = no_edge;
+    for (; j + 8 <= stride; j += 8)
+    {
+        __m256i weights = _mm256_load_si256((const __m256i *)(row + j));
+        __m256i mask = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)(allowed + j)));
+        lanes = _mm256_min_epi32(lanes, _mm256_blendv_epi8(no_edge, weights, mask));
+    }
+    __m128i half = _mm_min_epi32(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1));
+    half = _mm_min_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_min_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return masked_row_min_scalar(row, allowed, j, stride, (int32_t)_mm_cvtsi128_si32(half));
+}
+
+__attribute__((target("sse4.1"))) int32_t masked_row_min_sse4_1(const int32_t *row, const uint8_t *allowed, int stride)
+{
+    int j = 0;
+    __m128i no_edge = _mm_set1_epi32(INT_MAX);
+    __m128i lanes = no_edge;
+    for (; j + 4 <= stride; j += 4)
+    {
+        __m128i weights = _mm_load_si128((const __m128i *)(row + j));
+        int flags;
+        memcpy(&flags, allowed + j, sizeof(flags));
+        __m128i mask = _mm_cvtepi8_epi32(_mm_cvtsi32_si128(flags));
+        lanes = _mm_min_epi32(lanes, _mm_blendv_epi8(no_edge, weights, mask));
+    }
+    lanes = _mm_min_epi32(lanes, _mm_shuffle_epi32(lanes, _MM_SHUFFLE(1, 0, 3, 2)));
+    lanes = _mm_min_epi32(lanes, _mm_shuffle_epi32(lanes, _MM_SHUFFLE(2, 3, 0, 1)));
+    return masked_row_min_scalar(row, allowed, j, stride, (int32_t)_mm_cvtsi128_si32(lanes));
+}
+#endif
+
+// Widest scan the CPU running the program supports
+template <typename Weight>
+inline Weight masked_row_min(const Weight *row, const uint8_t *allowed, int stride)
+{
+#if defined(DISTANCE_SIMD_DISPATCH)
+    if (SIMD_LEVEL == SIMD_AVX2)
+        return masked_row_min_avx2(row, allowed, stride);
+    if (SIMD_LEVEL == SIMD_SSE4_1)
+        return masked_row_min_sse4_1(row, allowed, stride);
+#endif
+    return masked_row_min_scalar(row, allowed, 0, stride, DistanceMatrix<Weight>::NO_EDGE);
+}
+
+// Sum over the rows flagged in `rows` of their minimum over the columns flagged in
+// `columns`, or INT_MAX if some flagged row has no allowed column
+template <typename Weight>
+int masked_row_minima_sum(const DistanceMatrix<Weight> &matrix, const uint8_t *rows, const uint8_t *columns)
+{
+    long long total = 0;
+    for (int i = 0; i < matrix.num_cities; i++)
+    {
+        if (!rows[i])
+            continue;
+        Weight best = masked_row_min(matrix.row(i), columns, matrix.stride);
+        if (best == DistanceMatrix<Weight>::NO_EDGE)
+            return INT_MAX;
+        total += best;
+    }
+    return total < INT_MAX ? (int)total : INT_MAX;
+}
+
+// Width-dispatched versions of the helpers above
+int compact_row_min(const CompactDistances &compact, int i, const uint8_t *allowed)
+{
+    switch (compact.width)
+    {
+    case DISTANCE_UINT8:
+    {
+        uint8_t best = masked_row_min(compact.narrow.row(i), allowed, compact.narrow.stride);
+        return best == DistanceMatrix<uint8_t>::NO_EDGE ? INT_MAX : best;
+    }
+    case DISTANCE_UINT16:
+    {
+        uint16_t best = masked_row_min(compact.medium.row(i), allowed, compact.medium.stride);
+        return best == DistanceMatrix<uint16_t>::NO_EDGE ? INT_MAX : best;
+    }
+    default:
+        return masked_row_min(compact.wide.row(i), allowed, compact.wide.stride);
+    }
+}
+
+int compact_row_minima_sum(const CompactDistances &compact, const uint8_t *rows, const uint8_t *columns)
+{
+    switch (compact.width)
+    {
+    case DISTANCE_UINT8:
+        return masked_row_minima_sum(compact.narrow, rows, columns);
+    case DISTANCE_UINT16:
+        return masked_row_minima_sum(compact.medium, rows, columns);
+    default:
+        return masked_row_minima_sum(compact.wide, rows, columns);
+    }
+}
+
+// Padded row length, which is also the length the masks passed above must have
+int compact_stride(const CompactDistances &compact)
+{
+    switch (compact.width)
+    {
+    case DISTANCE_UINT8:
+        return compact.narrow.stride;
+    case DISTANCE_UINT16:
+        return compact.medium.stride;
+    default:
+        return compact.wide.stride;
+    }
+}
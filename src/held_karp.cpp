@@ -0,0 +1,137 @@
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// The DP table holds 2^(n-1) * (n-1) ints, so 26 cities already need ~3.3 GB
+const int HELD_KARP_MAX_CITIES = 26;
+
+// Fills masks with every subset of `bits` bits having exactly `popcount` bits set,
+// in increasing order (Gosper's hack)
+void subsets_with_popcount(std::vector<uint32_t> &masks, int bits, int popcount)
+{
+    masks.clear();
+    uint32_t limit = 1u << bits;
+    uint32_t mask = (1u << popcount) - 1;
+    while (mask < limit)
+    {
+        masks.push_back(mask);
+        uint32_t lowest = mask & -mask;
+        uint32_t ripple = mask + lowest;
+        mask = (((ripple ^ mask) >> 2) / lowest) | ripple;
+    }
+}
+
+// The loader checks this as soon as DIMENSION is known, so an unsupported size fails
+// before the matrix is allocated instead of printing an empty result
+bool held_karp_supported(int num_cities)
+{
+    if (num_cities < 2 || num_cities > HELD_KARP_MAX_CITIES)
+    {
+        std::cerr << "Error: Held-Karp supports 2 to " << HELD_KARP_MAX_CITIES << " cities." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Exact TSP by Held-Karp dynamic programming. City 0 is the fixed start; bit i of a
+// mask stands for city i + 1. dp[mask * m + j] is the cheapest path that leaves city 0,
+// visits exactly the cities in mask and ends at city j + 1. Subsets are processed
+// layer by layer (by popcount), and each layer only reads the previous one, so the
+// masks of a layer are split across OpenMP threads without any synchronization.
+std::pair<std::vector<int>, int> held_karp_tsp(std::vector<int> &distances, int num_cities)
+{
+    if (!held_karp_supported(num_cities))
+        return {std::vector<int>(), INT_MAX};
+
+    const int m = num_cities - 1;
+    const uint32_t full = (1u << m) - 1;
+
+    // dist_to[j * m + i] is the distance from city i + 1 to city j + 1, so the inner
+    // loop over predecessors walks a contiguous row instead of a matrix column
+    std::vector<int> dist_to(m * m);
+    for (int j = 0; j < m; j++)
+    {
+        for (int i = 0; i < m; i++)
+        {
+            dist_to[j * m + i] = distances[(i + 1) * num_cities + (j + 1)];
+        }
+    }
+
+    // Each mask owns a contiguous row of m entries, so a state and all of its
+    // predecessors' rows are read with unit stride
+    std::vector<int> dp((size_t)(full + 1) * m, INT_MAX);
+    for (int j = 0; j < m; j++)
+    {
+        dp[((size_t)1 << j) * m + j] = distances[j + 1];
+    }
+
+    std::vector<uint32_t> layer;
+    for (int k = 2; k <= m; k++)
+    {
+        subsets_with_popcount(layer, m, k);
+        int layer_size = layer.size();
+
+#pragma omp parallel for schedule(static)
+        for (int s = 0; s < layer_size; s++)
+        {
+            uint32_t mask = layer[s];
+            int *row = &dp[(size_t)mask * m];
+            for (uint32_t last_bits = mask; last_bits; last_bits &= last_bits - 1)
+            {
+                int j = __builtin_ctz(last_bits);
+                uint32_t prev = mask ^ (1u << j);
+                const int *prev_row = &dp[(size_t)prev * m];
+                const int *to_j = &dist_to[j * m];
+                int best = INT_MAX;
+                for (uint32_t prev_bits = prev; prev_bits; prev_bits &= prev_bits - 1)
+                {
+                    int i = __builtin_ctz(prev_bits);
+                    int candidate = prev_row[i] + to_j[i];
+                    if (candidate < best)
+                    {
+                        best = candidate;
+                    }
+                }
+                row[j] = best;
+            }
+        }
+    }
+
+    // Close the tour back to city 0
+    int best_distance = INT_MAX;
+    int last = 0;
+    const int *full_row = &dp[(size_t)full * m];
+    for (int j = 0; j < m; j++)
+    {
+        int candidate = full_row[j] + distances[(j + 1) * num_cities];
+        if (candidate < best_distance)
+        {
+            best_distance = candidate;
+            last = j;
+        }
+    }
+
+    // Walk the table backwards to recover the tour without storing parents
+    std::vector<int> path(num_cities);
+    path[0] = 0;
+    uint32_t mask = full;
+    for (int position = m; position >= 1; position--)
+    {
+        path[position] = last + 1;
+        uint32_t prev = mask ^ (1u << last);
+        int value = dp[(size_t)mask * m + last];
+        for (uint32_t prev_bits = prev; prev_bits; prev_bits &= prev_bits - 1)
+        {
+            int i = __builtin_ctz(prev_bits);
+            if (dp[(size_t)prev * m + i] + dist_to[last * m + i] == value)
+            {
+                last = i;
+                break;
+            }
+        }
+        mask = prev;
+    }
+
+    return {path, best_distance};
+}
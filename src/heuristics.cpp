@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <climits>
+#include <numeric>
+#include <vector>
+
+// Construction and local search for the initial incumbent. The exact search prunes
+// against the best tour known, so a near-optimal start is the cheapest pruning win.
+// Nearest-neighbor tours and the symmetric local search are the heuristic solver's
+// (lin_kernighan.cpp), run over the first HEURISTIC_CANDIDATES neighbors of each city.
+
+int tour_length(const std::vector<int> &distances, int num_cities, const std::vector<int> &tour)
+{
+    int total = 0;
+    for (int k = 0; k < num_cities; k++)
+    {
+        total += distances[tour[k] * num_cities + tour[(k + 1) % num_cities]];
+    }
+    return total;
+}
+
+// Repeatedly adds the cheapest edge that keeps every city at degree <= 2 and closes
+// no cycle early. Edges are weighed in both directions, so asymmetric instances get
+// an undirected tour whose direction is fixed afterwards.
+std::vector<int> greedy_edge_tour(const std::vector<int> &distances, int num_cities)
+{
+    const int n = num_cities;
+    std::vector<std::pair<int, int>> edges;
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = i + 1; j < n; j++)
+        {
+            edges.push_back(std::make_pair(i, j));
+        }
+    }
+    std::sort(edges.begin(), edges.end(), [&](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+        return distances[a.first * n + a.second] + distances[a.second * n + a.first] <
+               distances[b.first * n + b.second] + distances[b.second * n + b.first];
+    });
+
+    std::vector<int> degree(n, 0), component(n);
+    std::iota(component.begin(), component.end(), 0);
+    std::vector<std::vector<int>> adjacent(n);
+    int added = 0;
+    for (const std::pair<int, int> &edge : edges)
+    {
+        if (added == n - 1)
+            break;
+        int a = edge.first, b = edge.second;
+        if (degree[a] == 2 || degree[b] == 2)
+            continue;
+        int root_a = a, root_b = b;
+        while (component[root_a] != root_a)
+            root_a = component[root_a] = component[component[root_a]];
+        while (component[root_b] != root_b)
+            root_b = component[root_b] = component[component[root_b]];
+        if (root_a == root_b)
+            continue;
+        component[root_a] = root_b;
+        degree[a]++;
+        degree[b]++;
+        adjacent[a].push_back(b);
+        adjacent[b].push_back(a);
+        added++;
+    }
+
+    // The edges form one Hamiltonian path; walk it from an end
+    std::vector<int> tour;
+    int city = 0;
+    while (n > 1 && degree[city] != 1)
+        city++;
+    int previous = -1;
+    for (int k = 0; k < n; k++)
+    {
+        tour.push_back(city);
+        int next = -1;
+        for (int other : adjacent[city])
+        {
+            if (other != previous)
+                next = other;
+        }
+        previous = city;
+        city = next;
+    }
+    return tour;
+}
+
+// Or-opt: move a segment of 1..OR_OPT_MAX_SEGMENT cities, kept in its direction, to
+// between a candidate of its first city and that candidate's successor. Unlike the
+// heuristic solver's moves it reverses nothing, so it also suits asymmetric instances.
+bool or_opt(const std::vector<int> &distances, const std::vector<int> &candidates, int num_cities, std::vector<int> &tour)
+{
+    const int n = num_cities;
+    bool improved = false;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int length = 1; length <= OR_OPT_MAX_SEGMENT && length + 2 < n && !changed; length++)
+        {
+            for (int i = 0; i < n && !changed; i++)
+            {
+                int first = tour[i], last = tour[(i + length - 1) % n];
+                int before = tour[(i - 1 + n) % n], after = tour[(i + length) % n];
+                int removed = distances[before * n + first] + distances[last * n + after] - distances[before * n + after];
+
+                for (int t = 0; t < HEURISTIC_CANDIDATES; t++)
+                {
+                    int c = candidates[first * HEURISTIC_CANDIDATES + t];
+                    if (distances[c * n + first] >= removed)
+                        continue;
+                    int j = std::find(tour.begin(), tour.end(), c) - tour.begin();
+                    if ((j - i + n) % n < length || c == before)
+                        continue; // c is inside the segment or the segment already follows it
+                    int e = tour[(j + 1) % n];
+                    int inserted = distances[c * n + first] + distances[last * n + e] - distances[c * n + e];
+                    if (inserted >= removed)
+                        continue;
+
+                    // Rotate so the segment starts the array, then reinsert it after c
+                    std::rotate(tour.begin(), tour.begin() + i, tour.end());
+                    std::vector<int> segment(tour.begin(), tour.begin() + length);
+                    tour.erase(tour.begin(), tour.begin() + length);
+                    int at = std::find(tour.begin(), tour.end(), c) - tour.begin() + 1;
+                    tour.insert(tour.begin() + at, segment.begin(), segment.end());
+                    changed = improved = true;
+                    break;
+                }
+            }
+        }
+    }
+    return improved;
+}
+
+// Symmetric tours get the heuristic solver's Lin-Kernighan local search, asymmetric
+// ones Or-opt
+void improve_tour(const TspInstance &instance, const std::vector<int> &candidates, bool symmetric, std::vector<int> &tour)
+{
+    if (instance.num_cities < 5)
+        return;
+    if (!symmetric)
+    {
+        or_opt(instance.distances, candidates, instance.num_cities, tour);
+        return;
+    }
+    ArrayTour array;
+    init_array_tour(array, tour);
+    LocalSearch search;
+    init_local_search(search, array);
+    improve_array_tour(instance, candidates, array, search);
+    tour.swap(array.order);
+}
+
+// Best improved tour over nearest-neighbor runs from start cities first, first + stride, ...
+// plus greedy-edge when first == 0, rotated to begin at start_city. The starts are split
+// across the OpenMP team; MPI ranks pass their rank and size to share them out.
+std::pair<std::vector<int>, int> initial_tour(
+    const std::vector<int> &distances,
+    const std::vector<int> &neighbors,
+    int num_cities,
+    int start_city,
+    int first,
+    int stride)
+{
+    const bool symmetric = is_symmetric(distances, num_cities);
+    TspInstance instance;
+    instance.num_cities = num_cities;
+    instance.distances = distances;
+    std::vector<int> candidates;
+    copy_candidate_lists(neighbors, num_cities, num_cities, num_cities - 1, candidates);
+    std::vector<int> best_tour;
+    int best_distance = INT_MAX;
+
+#pragma omp parallel for schedule(dynamic)
+    for (int start = first - 1; start < num_cities; start += stride)
+    {
+        // start == -1 stands for the greedy-edge tour
+        std::vector<int> tour = start < 0 ? greedy_edge_tour(distances, num_cities)
+                                          : nearest_neighbor_tour(instance, candidates, start);
+        if (!symmetric && start < 0)
+        {
+            std::vector<int> reversed(tour.rbegin(), tour.rend());
+            if (tour_length(distances, num_cities, reversed) < tour_length(distances, num_cities, tour))
+                tour.swap(reversed);
+        }
+        improve_tour(instance, candidates, symmetric, tour);
+        int distance = tour_length(distances, num_cities, tour);
+#pragma omp critical(initial_tour)
+        {
+            if (distance < best_distance)
+            {
+                best_distance = distance;
+                best_tour = tour;
+            }
+        }
+    }
+
+    std::rotate(best_tour.begin(), std::find(best_tour.begin(), best_tour.end(), start_city), best_tour.end());
+    return {best_tour, best_distance};
+}
@@ -0,0 +1,442 @@
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <random>
+#include <unistd.h>
+#include <mpi.h>
+#include <omp.h>
+#include "utils.h"
+#include "mpi_scheduler.cpp"
+#include "task_search.cpp"
+#include "batch_tasks.cpp"
+
+int min_distance = INT_MAX;
+std::vector<int> min_path;
+
+std::vector<int> distances;
+std::vector<int> neighbors;
+int num_cities;
+
+int main(int argc, char *argv[])
+{
+    // One rank per node (or socket) with an OpenMP team inside; MPI calls are made
+    // by one thread at a time
+    int rank, size, provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (provided < MPI_THREAD_SERIALIZED)
+    {
+        if (rank == 0)
+        {
+            std::cerr << "Error: MPI library does not support MPI_THREAD_SERIALIZED." << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    double start_time, end_time, global_start_time, global_end_time;
+    global_start_time = trace_clock();
+    start_time = trace_clock();
+
+    SolverOptions options;
+    if (!parse_options(argc, argv, options))
+    {
+        if (rank == 0)
+        {
+            print_usage(argv[0]);
+        }
+        MPI_Finalize();
+        return 0;
+    }
+    AnytimeLimits limits;
+    anytime_init(limits, options.time_limit, options.gap);
+    std::string input_filename = options.input_filename;
+    std::string logs_filename = options.logs_filename;
+
+    // Get hostname
+    std::string hostname;
+    char hostnameArr[1024];
+    hostnameArr[1023] = '\0';
+    if (gethostname(hostnameArr, sizeof(hostnameArr)) == 0)
+    {
+        hostname = std::string(hostnameArr);
+    }
+    else
+    {
+        std::cerr << "Error getting hostname" << std::endl;
+        hostname = "Unknown";
+    }
+
+    // Buffer phase events per thread; only rank 0 clears the logs file
+    trace_init(logs_filename, hostname, options.trace_format, options.trace_sample, rank == 0);
+    stats_init(options.stats, rank);
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    // Batch mode: rank 0 deals instance files to the other ranks, whose teams solve them
+    // as tasks; the task-creating thread alone talks to rank 0 and forwards the results
+    if (options.batch)
+    {
+        int status = 0;
+        if (size == 1)
+        {
+            std::ifstream file;
+            std::istream *manifest;
+            if (open_manifest(input_filename, file, manifest))
+            {
+                batch_run_tasks(
+                    options, [&](std::string &filename) { return batch_next(*manifest, filename); }, batch_print);
+            }
+            else
+            {
+                status = 1;
+            }
+        }
+        else if (rank == 0)
+        {
+            status = batch_coordinate(options, size - 1);
+        }
+        else
+        {
+            std::string results;
+            auto next = [&](std::string &filename)
+            {
+                std::string lines;
+#pragma omp critical(batch_results)
+                lines.swap(results);
+                return batch_request(lines, filename);
+            };
+            auto report = [&](const std::string &line)
+            {
+#pragma omp critical(batch_results)
+                results += line + "\n";
+            };
+            batch_run_tasks(options, next, report);
+            batch_finish(results);
+        }
+        trace_finish();
+        MPI_Finalize();
+        return status;
+    }
+
+    // Setup: rank 0 reads the input file and draws the shuffle seed
+    unsigned int seed = 0;
+    TspInstance instance;
+    if (rank == 0)
+    {
+        if (options.solver == SOLVER_HEURISTIC)
+        {
+            num_cities = read_tsplib_instance(input_filename, instance, true);
+            if (num_cities > 0 && !heuristic_supported(instance))
+            {
+                num_cities = 0;
+            }
+        }
+        else
+        {
+            num_cities = read_tsplib_matrix(input_filename, distances, solver_cities_supported(options.solver));
+        }
+        std::random_device rd;
+        seed = rd();
+    }
+    end_time = trace_clock();
+    trace_event(TRACE_SETUP, rank, start_time, end_time);
+
+    // Share the matrix and the seed; this is the only startup traffic
+    start_time = trace_clock();
+    MPI_Bcast(&num_cities, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (num_cities == 0)
+    {
+        MPI_Finalize();
+        return 1;
+    }
+    if (options.solver == SOLVER_HEURISTIC)
+    {
+        broadcast_instance(instance, num_cities);
+    }
+    else
+    {
+        distances.resize(num_cities * num_cities);
+        MPI_Bcast(distances.data(), num_cities * num_cities, MPI_INT, 0, MPI_COMM_WORLD);
+    }
+    MPI_Bcast(&seed, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+    end_time = trace_clock();
+    trace_event(TRACE_COMMUNICATION, rank, start_time, end_time);
+
+    // Set starting city
+    int first_city = 0;
+
+    // Enumerate the pre-paths to be explored lazily. Every rank derives the same
+    // order from the shared seed, so chunks are just index ranges.
+    start_time = trace_clock();
+    PrefixEnumerator prefixes;
+    if (options.solver == SOLVER_BRANCH_AND_BOUND)
+    {
+        if (!init_prefixes(prefixes, num_cities, first_city, options.prefix_depth, size * omp_get_max_threads(), seed,
+                           options.prefix_order == ORDER_BOUND))
+        {
+            MPI_Finalize();
+            return 1;
+        }
+    }
+
+    // Resume from the checkpoint of an earlier job, if there is one, then rank the
+    // prefixes if they go in bound order
+    Checkpoint checkpoint;
+    if (options.solver == SOLVER_BRANCH_AND_BOUND &&
+        (!checkpoint_broadcast(checkpoint, prefixes, options, distances, num_cities, rank) ||
+         !order_prefixes_by_bound(prefixes, distances)))
+    {
+        MPI_Finalize();
+        return 1;
+    }
+    end_time = trace_clock();
+    trace_event(TRACE_SETUP, rank, start_time, end_time);
+
+    if (options.solver == SOLVER_HELD_KARP)
+    {
+        // The DP table is too large to replicate per rank, so rank 0 solves it alone with its team
+        if (rank == 0)
+        {
+            start_time = trace_clock();
+            std::pair<std::vector<int>, int> result = held_karp_tsp(distances, num_cities);
+            min_path = result.first;
+            min_distance = result.second;
+            end_time = trace_clock();
+            trace_event(TRACE_COMPUTATION, rank, start_time, end_time);
+        }
+    }
+    else if (options.solver == SOLVER_HEURISTIC)
+    {
+        // Every rank runs its own chained Lin-Kernighan workers, then all take the best tour
+        start_time = trace_clock();
+        std::pair<std::vector<int>, int> result =
+            heuristic_tour(instance, first_city, rank, size, omp_get_max_threads(), seed, limits);
+        end_time = trace_clock();
+        trace_event(TRACE_COMPUTATION, rank, start_time, end_time);
+
+        start_time = trace_clock();
+        best_tour_of_ranks(result, num_cities);
+        min_path = result.first;
+        min_distance = result.second;
+        end_time = trace_clock();
+        trace_event(TRACE_COMMUNICATION, rank, start_time, end_time);
+    }
+    else
+    {
+        // Each process improves tours from its share of the start cities, then all start
+        // from the best bound. The matrix, prefixes, bound tables and incumbent exist once
+        // per rank and are shared by its whole team.
+        start_time = trace_clock();
+        build_neighbor_lists(distances, num_cities, neighbors);
+        std::pair<std::vector<int>, int> result = initial_tour(distances, neighbors, num_cities, first_city, rank, size);
+        checkpoint_seed_tour(checkpoint, result);
+        struct
+        {
+            int distance;
+            int rank;
+        } initial = {result.second, rank};
+        MPI_Allreduce(MPI_IN_PLACE, &initial, 1, MPI_2INT, MPI_MINLOC, MPI_COMM_WORLD);
+        LowerBound bound;
+        init_lower_bound(bound, options.bound, distances, num_cities, first_city);
+        Incumbent incumbent;
+        init_incumbent(incumbent, result, num_cities);
+        incumbent_lower(incumbent, initial.distance);
+        DominanceMemo memo;
+        init_memo(memo, options.memo_megabytes);
+        SearchContext search;
+        init_search(search, distances, neighbors, num_cities, bound, incumbent);
+        attach_memo(search, memo);
+        attach_limits(search, limits);
+
+        // Only rank 0 learns which prefixes are finished, so only it can check the gap;
+        // the other ranks stop when it tells them to
+        anytime_attach(limits, prefixes, bound, distances, incumbent, checkpoint);
+        if (rank != 0)
+        {
+            limits.gap = -1;
+        }
+        if (rank == initial.rank)
+        {
+            anytime_publish(limits, result.second, result.first.data(), num_cities);
+        }
+        SearchPrefixFn search_prefix = search_prefix_for(num_cities);
+        if (search_prefix == nullptr)
+        {
+            MPI_Finalize();
+            return 1;
+        }
+        end_time = trace_clock();
+        trace_event(TRACE_COMPUTATION, rank, start_time, end_time);
+
+        // Expose the global bound for one-sided updates
+        start_time = trace_clock();
+        SharedBound shared_bound;
+        shared_bound_create(shared_bound, incumbent_distance(incumbent), limits, rank);
+        end_time = trace_clock();
+        trace_event(TRACE_COMMUNICATION, rank, start_time, end_time);
+
+        WorkPool pool = {0, (int)prefixes.count, &prefixes};
+        NodeQueue queue = {0, 0, false, 0.0, {}, {}};
+
+        stats_begin_search();
+#pragma omp parallel
+        {
+            int thread_id = omp_get_thread_num();
+            int num_threads = omp_get_num_threads();
+            int worker_id = rank * num_threads + thread_id;
+            SearchContext thread_search = search;
+            int prefix[KERNEL_MAX_CITIES];
+            std::vector<SavedStack> stacks;
+
+            if (rank == 0 && size > 1 && thread_id == 0)
+            {
+                // One thread of rank 0 serves the other ranks and relays the best bound
+                coordinate_work(pool, size - 1, incumbent, shared_bound, checkpoint, rank);
+            }
+            else if (rank == 0)
+            {
+                // The rest of rank 0 draws guided chunks straight from the pool
+                while (true)
+                {
+                    drop_hopeless_work(pool, incumbent_distance(incumbent), checkpoint, &limits);
+                    WorkChunk chunk = take_work(pool, size * num_threads);
+                    if (chunk.count == 0 || anytime_stopped(limits))
+                    {
+                        break;
+                    }
+                    for (int i = chunk.start; i < chunk.start + chunk.count && !anytime_stopped(limits); i++)
+                    {
+                        if (checkpoint_done(checkpoint, i) ||
+                            drop_hopeless_prefix(prefixes, i, incumbent, checkpoint, limits))
+                        {
+                            continue;
+                        }
+                        double computation_start = trace_clock();
+                        int prefix_length = prefix_at(prefixes, i, prefix);
+                        checkpoint_stacks(checkpoint, i, stacks);
+                        search_prefix(thread_search, prefix, prefix_length, &stacks);
+                        if (anytime_stopped(limits))
+                        {
+                            checkpoint_stop(checkpoint, i, stacks);
+                        }
+                        else
+                        {
+                            checkpoint_mark(checkpoint, i);
+                            anytime_mark(limits, i);
+                            checkpoint_tick(checkpoint, incumbent);
+                        }
+                        double computation_end = trace_clock();
+                        trace_event(TRACE_COMPUTATION, worker_id, computation_start, computation_end);
+                    }
+                }
+            }
+            else
+            {
+                // Other ranks share one queue per node, refilled from the coordinator. Finished
+                // prefixes go back with the node's requests so rank 0 can checkpoint them.
+                int i = -1;
+                while (true)
+                {
+                    double communication_start = trace_clock();
+                    i = next_node_prefix(queue, incumbent, shared_bound, i);
+                    double communication_end = trace_clock();
+                    trace_event(TRACE_COMMUNICATION, worker_id, communication_start, communication_end);
+                    if (i < 0)
+                    {
+                        break;
+                    }
+                    if (checkpoint_done(checkpoint, i) ||
+                        drop_hopeless_prefix(prefixes, i, incumbent, checkpoint, limits))
+                    {
+                        continue;
+                    }
+
+                    double computation_start = trace_clock();
+                    int prefix_length = prefix_at(prefixes, i, prefix);
+                    checkpoint_stacks(checkpoint, i, stacks);
+                    search_prefix(thread_search, prefix, prefix_length, &stacks);
+                    if (anytime_stopped(limits))
+                    {
+                        checkpoint_stop(checkpoint, i, stacks);
+                        i = -1; // Cut short, so not reported as finished
+                    }
+                    double computation_end = trace_clock();
+                    trace_event(TRACE_COMPUTATION, worker_id, computation_start, computation_end);
+                }
+            }
+            stats_add_search(thread_search, worker_id);
+        }
+        stats_end_search();
+
+        // Final gather of results from all processes
+        start_time = trace_clock();
+        shared_bound_free(shared_bound);
+        struct
+        {
+            int distance;
+            int rank;
+        } local_result, global_result;
+
+        std::vector<int> local_min_path;
+        local_result.distance = incumbent_read(incumbent, local_min_path);
+        local_result.rank = rank;
+
+        MPI_Allreduce(&local_result, &global_result, 1, MPI_2INT, MPI_MINLOC, MPI_COMM_WORLD);
+
+        int path_size = num_cities;
+        // Broadcast the best path
+        if (rank == global_result.rank)
+        {
+            path_size = local_min_path.size();
+            min_path = local_min_path;
+        }
+
+        // Broadcast the size of the best path
+        MPI_Bcast(&path_size, 1, MPI_INT, global_result.rank, MPI_COMM_WORLD);
+
+        // Resize min_path on all processes to receive the best path
+        min_path.resize(path_size);
+
+        // Broadcast the best path
+        MPI_Bcast(min_path.data(), path_size, MPI_INT, global_result.rank, MPI_COMM_WORLD);
+
+        min_distance = global_result.distance;
+
+        // Unless the search was stopped, it is complete and a job resuming from the
+        // checkpoint only prints the result
+        checkpoint_offer(checkpoint, min_distance, min_path.data(), num_cities);
+        if (!options.checkpoint_filename.empty())
+        {
+            checkpoint_gather_stacks(checkpoint, rank, size);
+        }
+        checkpoint_finish(checkpoint, incumbent, !anytime_stopped(limits));
+
+        end_time = trace_clock();
+        trace_event(TRACE_COMMUNICATION, rank, start_time, end_time);
+    }
+
+    global_end_time = trace_clock();
+    double total_time = global_end_time - global_start_time;
+
+    // Print the final results (only on rank 0)
+    if (rank == 0)
+    {
+        std::cout << "---------------------------------------------" << std::endl;
+        std::cout << "Total execution time: " << total_time << " seconds" << std::endl;
+        std::cout << "Minimum distance: " << min_distance << std::endl;
+        std::cout << "Minimum path: ";
+        for (int i = 0; i < (int)min_path.size(); i++)
+        {
+            std::cout << min_path[i] + 1 << " "; // +1 because cities are typically 1-indexed in output
+        }
+        std::cout << std::endl;
+        anytime_print(limits, min_distance, options.solver != SOLVER_HEURISTIC);
+        std::cout << "---------------------------------------------" << std::endl;
+    }
+
+    trace_finish();
+    stats_finish_ranks(rank, size);
+    MPI_Finalize();
+    return 0;
+}
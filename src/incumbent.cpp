@@ -0,0 +1,107 @@
+#include <atomic>
+#include <climits>
+#include <vector>
+
+// Best tour found so far, shared by every search thread of a process. The distance is
+// a lock-free CAS-min so pruning always sees the tightest bound with a relaxed load.
+// The tour itself changes only on improvement and is published through a seqlock:
+// an odd sequence number means a writer is copying the path.
+struct Incumbent
+{
+    std::atomic<int> distance;
+    std::atomic<unsigned> sequence;
+    std::atomic<int> path_distance; // Distance of the tour currently stored in path
+    std::vector<std::atomic<int>> path;
+
+    Incumbent() : distance(INT_MAX), sequence(0), path_distance(INT_MAX) {}
+};
+
+void init_incumbent(Incumbent &incumbent, const std::pair<std::vector<int>, int> &initial, int num_cities)
+{
+    std::vector<std::atomic<int>> path(num_cities);
+    incumbent.path.swap(path);
+    for (int i = 0; i < num_cities && i < (int)initial.first.size(); i++)
+    {
+        incumbent.path[i].store(initial.first[i], std::memory_order_relaxed);
+    }
+    incumbent.path_distance.store(initial.second, std::memory_order_relaxed);
+    incumbent.sequence.store(0, std::memory_order_relaxed);
+    incumbent.distance.store(initial.second, std::memory_order_release);
+}
+
+inline int incumbent_distance(const Incumbent &incumbent)
+{
+    return incumbent.distance.load(std::memory_order_relaxed);
+}
+
+// Lowers the shared bound to `distance` if it improves on it. Returns true if the bound moved.
+bool incumbent_lower(Incumbent &incumbent, int distance)
+{
+    int current = incumbent.distance.load(std::memory_order_relaxed);
+    while (distance < current)
+    {
+        if (incumbent.distance.compare_exchange_weak(current, distance, std::memory_order_relaxed))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Offers a complete tour. Returns true if it became the new incumbent.
+bool incumbent_offer(Incumbent &incumbent, int distance, const int *path, int num_cities)
+{
+    if (!incumbent_lower(incumbent, distance))
+    {
+        return false;
+    }
+
+    // Take the writer side of the seqlock
+    unsigned sequence = incumbent.sequence.load(std::memory_order_relaxed);
+    while (true)
+    {
+        if ((sequence & 1) == 0 &&
+            incumbent.sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire))
+        {
+            break;
+        }
+        sequence = incumbent.sequence.load(std::memory_order_relaxed);
+    }
+
+    // A better tour may have been offered while we waited; its writer will store it
+    if (distance < incumbent.path_distance.load(std::memory_order_relaxed) &&
+        distance == incumbent.distance.load(std::memory_order_relaxed))
+    {
+        for (int i = 0; i < num_cities; i++)
+        {
+            incumbent.path[i].store(path[i], std::memory_order_relaxed);
+        }
+        incumbent.path_distance.store(distance, std::memory_order_relaxed);
+    }
+    incumbent.sequence.store(sequence + 2, std::memory_order_release);
+    return true;
+}
+
+// Copies a consistent snapshot of the best tour and returns its distance
+int incumbent_read(const Incumbent &incumbent, std::vector<int> &path)
+{
+    path.resize(incumbent.path.size());
+    while (true)
+    {
+        unsigned before = incumbent.sequence.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            continue;
+        }
+        int distance = incumbent.path_distance.load(std::memory_order_relaxed);
+        for (int i = 0; i < (int)path.size(); i++)
+        {
+            path[i] = incumbent.path[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (incumbent.sequence.load(std::memory_order_relaxed) == before)
+        {
+            return distance;
+        }
+    }
+}
@@ -0,0 +1,480 @@
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <time.h>
+#include <type_traits>
+#include <vector>
+
+// Instance sizes with a dedicated instantiation; other sizes up to
+// KERNEL_MAX_CITIES run the generic kernel with a runtime city count
+const int KERNEL_MIN_SPECIALIZED = 8;
+const int KERNEL_MAX_SPECIALIZED = 32;
+const int KERNEL_MAX_CITIES = 64;
+
+// A tour a search context published as the new incumbent
+struct TourImprovement
+{
+    double time; // CLOCK_MONOTONIC seconds
+    int distance;
+};
+
+// Per-thread state of the branch-and-bound search over prefixes
+struct SearchContext
+{
+    const std::vector<int> *distances;
+    const int *matrix;
+    const int *neighbors; // Row i: the other cities by increasing distance from i
+    int num_cities;
+    bool symmetric; // Search only one orientation of each tour
+    LowerBound bound;
+    Incumbent *incumbent;                   // Shared by all threads of the process
+    long long nodes[KERNEL_MAX_CITIES + 1];  // Children examined, by path length
+    long long pruned[KERNEL_MAX_CITIES + 1]; // Examined children cut by a bound
+    std::vector<TourImprovement> improvements;
+    DominanceMemo *memo; // Shared by all threads of the process; nullptr if disabled
+    long long memo_counts[MEMO_COUNTERS];
+    AnytimeLimits *limits; // nullptr unless the run may stop early
+    int poll_countdown;    // Nodes left until the limits are checked again
+};
+
+// Lets the bound code index a bitmask like the old visited vector
+template <typename Mask>
+struct MaskView
+{
+    Mask mask;
+    bool operator[](int i) const { return (mask >> i) & 1; }
+};
+
+inline int lowest_bit(uint32_t mask) { return __builtin_ctz(mask); }
+inline int lowest_bit(uint64_t mask) { return __builtin_ctzll(mask); }
+
+template <typename Mask>
+inline Mask low_bits(int count)
+{
+    return count >= (int)(8 * sizeof(Mask)) ? ~(Mask)0 : (((Mask)1 << count) - 1);
+}
+
+// N == 0 is the generic kernel: city count read at runtime, 64-bit masks
+template <int N>
+struct KernelTraits
+{
+    typedef typename std::conditional<(N > 0 && N <= 32), uint32_t, uint64_t>::type Mask;
+    static const int CAPACITY = N > 0 ? N : KERNEL_MAX_CITIES;
+};
+
+template <int N>
+struct KernelState
+{
+    typedef typename KernelTraits<N>::Mask Mask;
+    int path[KernelTraits<N>::CAPACITY];
+    Mask visited;
+};
+
+void init_search(
+    SearchContext &search,
+    const std::vector<int> &distances,
+    const std::vector<int> &neighbors,
+    int num_cities,
+    const LowerBound &bound,
+    Incumbent &incumbent)
+{
+    search.distances = &distances;
+    search.matrix = distances.data();
+    search.neighbors = neighbors.data();
+    search.num_cities = num_cities;
+    search.symmetric = num_cities >= 3 && is_symmetric(distances, num_cities);
+    search.bound = bound;
+    search.incumbent = &incumbent;
+    for (int d = 0; d <= KERNEL_MAX_CITIES; d++)
+    {
+        search.nodes[d] = 0;
+        search.pruned[d] = 0;
+    }
+    search.improvements.clear();
+    search.memo = nullptr;
+    for (int c = 0; c < MEMO_COUNTERS; c++)
+    {
+        search.memo_counts[c] = 0;
+    }
+    search.limits = nullptr;
+    search.poll_countdown = ANYTIME_POLL_NODES;
+}
+
+// Lets a search prune against the dominance memo, unless it is disabled
+void attach_memo(SearchContext &search, DominanceMemo &memo)
+{
+    search.memo = memo.words.empty() ? nullptr : &memo;
+}
+
+// Lets a search stop early and stream its tours, if the run has a time limit or gap
+void attach_limits(SearchContext &search, AnytimeLimits &limits)
+{
+    search.limits = limits.enabled ? &limits : nullptr;
+}
+
+// Whether the search should give up, checked every ANYTIME_POLL_NODES nodes
+inline bool search_stopped(SearchContext &search)
+{
+    if (search.limits == nullptr || --search.poll_countdown > 0)
+        return false;
+    search.poll_countdown = ANYTIME_POLL_NODES;
+    return anytime_poll(*search.limits);
+}
+
+// Whether a cheaper path over the same cities to the same end is already known. Only
+// paths long enough to have rivals and short enough to be worth a lookup are checked.
+inline bool path_dominated(SearchContext &search, uint64_t visited, const int *path, int length, int cost)
+{
+    return search.memo != nullptr && length >= MEMO_MIN_LENGTH && search.num_cities - length >= MEMO_MIN_REMAINING &&
+           memo_dominated(*search.memo, visited, path[length - 1], search.symmetric ? path[1] : -1, cost,
+                          search.memo_counts);
+}
+
+// Orientation symmetry breaking: on a symmetric instance a tour and its reverse cost
+// the same, so only the orientation whose second city is lower than its last one is
+// searched. A path stays open while some city above its second one is unvisited.
+template <typename Mask>
+inline bool orientation_open(Mask visited, int second, int num_cities)
+{
+    return (~visited & low_bits<Mask>(num_cities) & ~low_bits<Mask>(second + 1)) != 0;
+}
+
+// Whether a partial path of `length` cities (or a full tour) keeps the searched orientation
+template <int N>
+inline bool orientation_allowed(const SearchContext &search, const KernelState<N> &state, int length)
+{
+    const int n = N > 0 ? N : search.num_cities;
+    if (!search.symmetric || length < 2)
+        return true;
+    if (length == n)
+        return state.path[n - 1] > state.path[1];
+    return orientation_open(state.visited, state.path[1], n);
+}
+
+// Offers a finished tour and logs it if it became the incumbent (rare, so the clock read is free)
+inline void publish_tour(SearchContext &search, int distance, const int *path, int num_cities)
+{
+    if (incumbent_offer(*search.incumbent, distance, path, num_cities))
+    {
+        struct timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        search.improvements.push_back({time.tv_sec + time.tv_nsec / 1e9, distance});
+        if (search.limits != nullptr)
+            anytime_publish(*search.limits, distance, path, num_cities);
+    }
+}
+
+// Explicit DFS frontier. The frame for path length d is (path[d - 1], untried[d], cost[d]):
+// the city reached, the children not tried yet and the distance so far. Bit k of
+// untried[d] stands for the k-th nearest neighbor of path[d - 1], so taking the lowest
+// bit tries children nearest first. Frames from `base` (the prefix the search started
+// from) up to `depth` are live. Being plain data, a stack can be split, copied to
+// another thread or sent to another rank.
+template <int N>
+struct SearchStack
+{
+    typedef typename KernelTraits<N>::Mask Mask;
+    KernelState<N> state;
+    Mask untried[KernelTraits<N>::CAPACITY + 1];
+    int cost[KernelTraits<N>::CAPACITY + 1];
+    int base;
+    int depth;
+};
+
+// Unvisited entries of a neighbor list, as a mask over list positions
+template <typename Mask>
+inline Mask unvisited_neighbors(const int *candidates, int count, Mask visited)
+{
+    Mask untried = 0;
+    for (int k = 0; k < count; k++)
+    {
+        untried |= (Mask)(~(visited >> candidates[k]) & 1) << k;
+    }
+    return untried;
+}
+
+template <int N>
+void stack_init(SearchStack<N> &stack, const SearchContext &search, const KernelState<N> &state, int depth, int curr_distance)
+{
+    const int n = N > 0 ? N : search.num_cities;
+    stack.state = state;
+    stack.base = depth;
+    stack.depth = depth;
+    stack.cost[depth] = curr_distance;
+    stack.untried[depth] = unvisited_neighbors(search.neighbors + state.path[depth - 1] * n, n - 1, state.visited);
+}
+
+// Copies the live frames out, for a checkpoint
+template <int N>
+void stack_save(const SearchStack<N> &stack, SavedStack &saved)
+{
+    saved.base = stack.base;
+    saved.depth = stack.depth;
+    saved.path.assign(stack.state.path, stack.state.path + stack.depth);
+    saved.cost.assign(stack.cost + stack.base, stack.cost + stack.depth + 1);
+    saved.untried.assign(stack.untried + stack.base, stack.untried + stack.depth + 1);
+}
+
+template <int N>
+void stack_load(SearchStack<N> &stack, const SavedStack &saved)
+{
+    typedef typename KernelTraits<N>::Mask Mask;
+    stack.base = saved.base;
+    stack.depth = saved.depth;
+    stack.state.visited = 0;
+    for (int j = 0; j < saved.depth; j++)
+    {
+        stack.state.path[j] = saved.path[j];
+        stack.state.visited |= (Mask)1 << saved.path[j];
+    }
+    for (int d = saved.base; d <= saved.depth; d++)
+    {
+        stack.cost[d] = saved.cost[d - saved.base];
+        stack.untried[d] = (Mask)saved.untried[d - saved.base];
+    }
+}
+
+// Moves the oldest untried branches, the far half of the shallowest frame that still
+// has more than one, into `donated`. Only frames up to path length `max_depth` are
+// split. Returns false if there is nothing worth splitting.
+template <int N>
+bool stack_split(SearchStack<N> &stack, SearchStack<N> &donated, int max_depth = KERNEL_MAX_CITIES)
+{
+    typedef typename KernelTraits<N>::Mask Mask;
+    for (int d = stack.base; d <= stack.depth && d <= max_depth; d++)
+    {
+        Mask untried = stack.untried[d];
+        int count = __builtin_popcountll(untried);
+        if (count < 2)
+            continue;
+
+        // The lower half stays: those are the nearest children, which this stack tries first
+        Mask given = untried;
+        for (int k = 0; k < count / 2; k++)
+            given &= given - 1;
+        stack.untried[d] = untried & ~given;
+
+        donated.state.visited = 0;
+        for (int j = 0; j < d; j++)
+        {
+            donated.state.path[j] = stack.state.path[j];
+            donated.state.visited |= (Mask)1 << stack.state.path[j];
+        }
+        donated.base = d;
+        donated.depth = d;
+        donated.cost[d] = stack.cost[d];
+        donated.untried[d] = given;
+        return true;
+    }
+    return false;
+}
+
+// Searches the live frames until they are exhausted or `max_nodes` children have been
+// examined. Returns true when done; otherwise the stack can be split or resumed later.
+template <int N>
+bool stack_run(SearchContext &search, SearchStack<N> &stack, long long max_nodes = LLONG_MAX)
+{
+    typedef typename KernelTraits<N>::Mask Mask;
+    const int n = N > 0 ? N : search.num_cities;
+    const int base = stack.base;
+    int *path = stack.state.path;
+    Mask visited = stack.state.visited;
+    int d = stack.depth;
+
+    MaskView<Mask> reset_view = {visited};
+    bound_reset(search.bound, reset_view);
+    search.bound.closing_above = search.symmetric && d >= 2 ? path[1] : -1;
+
+    // A prefix that is already a full tour only needs closing
+    if (d == n)
+    {
+        if (!orientation_allowed<N>(search, stack.state, n))
+        {
+            stack.untried[base] = 0;
+            return true;
+        }
+        int dist = stack.cost[d] + search.matrix[path[d - 1] * n + path[0]];
+        if (dist < incumbent_distance(*search.incumbent))
+        {
+            publish_tour(search, dist, path, n);
+        }
+        stack.depth = base;
+        stack.untried[base] = 0;
+        return true;
+    }
+
+    bool done = true;
+    while (true)
+    {
+        Mask untried = stack.untried[d];
+        if (untried == 0)
+        {
+            // Frame exhausted: backtrack, leaving the prefix itself in place
+            if (d == base)
+                break;
+            d--;
+            visited &= ~((Mask)1 << path[d]);
+            bound_unvisit(search.bound, path[d]);
+            if (d == 1)
+                search.bound.closing_above = -1; // The second city is open again
+            continue;
+        }
+        if (max_nodes-- == 0 || search_stopped(search))
+        {
+            done = false;
+            break;
+        }
+        const int last = path[d - 1];
+        int i = search.neighbors[last * n + lowest_bit(untried)];
+        stack.untried[d] = untried & (untried - 1);
+        search.nodes[d + 1]++;
+
+        // Re-read the shared bound for every child so other threads' tours prune immediately
+        int min_distance = incumbent_distance(*search.incumbent);
+        int next_distance = stack.cost[d] + search.matrix[last * n + i];
+        if (next_distance + bound_floor(search.bound) >= min_distance)
+        {
+            // Children come nearest first, so none of the remaining ones can do better
+            stack.untried[d] = 0;
+            search.pruned[d + 1]++;
+            continue;
+        }
+
+        if (d + 1 == n)
+        {
+            // Last city: close the tour, in the searched orientation only
+            if (search.symmetric && i < path[1])
+            {
+                search.pruned[d + 1]++;
+                continue;
+            }
+            int dist = next_distance + search.matrix[i * n + path[0]];
+            if (dist < min_distance)
+            {
+                path[d] = i;
+                publish_tour(search, dist, path, n);
+            }
+            continue;
+        }
+
+        visited |= (Mask)1 << i;
+        if (search.symmetric)
+        {
+            int second = d == 1 ? i : path[1];
+            if (!orientation_open(visited, second, n))
+            {
+                // No city left to end the tour above the second one
+                visited &= ~((Mask)1 << i);
+                search.pruned[d + 1]++;
+                continue;
+            }
+            if (d == 1)
+                search.bound.closing_above = i;
+        }
+        bound_visit(search.bound, i);
+        MaskView<Mask> view = {visited};
+        int cutoff = min_distance - next_distance;
+        path[d] = i;
+        if (bound_remaining(search.bound, view, i, *search.distances, cutoff) >= cutoff ||
+            path_dominated(search, visited, path, d + 1, next_distance))
+        {
+            bound_unvisit(search.bound, i);
+            visited &= ~((Mask)1 << i);
+            if (d == 1)
+                search.bound.closing_above = -1;
+            search.pruned[d + 1]++;
+            continue;
+        }
+
+        // Push the child's frame
+        d++;
+        stack.cost[d] = next_distance;
+        stack.untried[d] = unvisited_neighbors(search.neighbors + i * n, n - 1, visited);
+    }
+    stack.state.visited = visited;
+    stack.depth = d;
+    return done;
+}
+
+// Searches below a prefix. If `stacks` holds the stacks an earlier job stopped in,
+// they are continued instead. A search that is stopped leaves the stacks still to
+// search in `stacks` (when given), and an empty list once the prefix is finished.
+template <int N>
+void search_prefix_n(SearchContext &search, const int *prefix, int prefix_length, std::vector<SavedStack> *stacks)
+{
+    typedef typename KernelTraits<N>::Mask Mask;
+    const int n = N > 0 ? N : search.num_cities;
+    SearchStack<N> stack;
+    if (stacks != nullptr && !stacks->empty())
+    {
+        while (!stacks->empty())
+        {
+            stack_load(stack, stacks->back());
+            if (!stack_run(search, stack))
+            {
+                stack_save(stack, stacks->back());
+                return;
+            }
+            stacks->pop_back();
+        }
+        return;
+    }
+
+    KernelState<N> state;
+    state.visited = 0;
+    int curr_distance = 0;
+    for (int j = 0; j < prefix_length; j++)
+    {
+        state.path[j] = prefix[j];
+        state.visited |= (Mask)1 << prefix[j];
+        if (j > 0)
+            curr_distance += search.matrix[prefix[j - 1] * n + prefix[j]];
+    }
+    if (!orientation_allowed<N>(search, state, prefix_length))
+        return; // Its reverse is covered by another prefix
+    if (path_dominated(search, state.visited, state.path, prefix_length, curr_distance))
+        return;
+
+    stack_init(stack, search, state, prefix_length, curr_distance);
+    if (!stack_run(search, stack) && stacks != nullptr)
+    {
+        stacks->resize(1);
+        stack_save(stack, stacks->back());
+    }
+}
+
+typedef void (*SearchPrefixFn)(SearchContext &, const int *, int, std::vector<SavedStack> *);
+
+const SearchPrefixFn SEARCH_PREFIX_TABLE[KERNEL_MAX_SPECIALIZED - KERNEL_MIN_SPECIALIZED + 1] = {
+    search_prefix_n<8>, search_prefix_n<9>, search_prefix_n<10>, search_prefix_n<11>,
+    search_prefix_n<12>, search_prefix_n<13>, search_prefix_n<14>, search_prefix_n<15>,
+    search_prefix_n<16>, search_prefix_n<17>, search_prefix_n<18>, search_prefix_n<19>,
+    search_prefix_n<20>, search_prefix_n<21>, search_prefix_n<22>, search_prefix_n<23>,
+    search_prefix_n<24>, search_prefix_n<25>, search_prefix_n<26>, search_prefix_n<27>,
+    search_prefix_n<28>, search_prefix_n<29>, search_prefix_n<30>, search_prefix_n<31>,
+    search_prefix_n<32>};
+
+// Whether the kernel takes an instance of this size; the loader checks before allocating
+bool branch_and_bound_supported(int num_cities)
+{
+    if (num_cities > KERNEL_MAX_CITIES)
+    {
+        std::cerr << "Error: Branch and bound supports at most " << KERNEL_MAX_CITIES << " cities." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Picks the kernel instantiation for an instance size, or nullptr if it is too large
+SearchPrefixFn search_prefix_for(int num_cities)
+{
+    if (num_cities >= KERNEL_MIN_SPECIALIZED && num_cities <= KERNEL_MAX_SPECIALIZED)
+    {
+        return SEARCH_PREFIX_TABLE[num_cities - KERNEL_MIN_SPECIALIZED];
+    }
+    if (branch_and_bound_supported(num_cities))
+    {
+        return search_prefix_n<0>;
+    }
+    return nullptr;
+}
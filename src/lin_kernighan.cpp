@@ -0,0 +1,516 @@
+#include <algorithm>
+#include <climits>
+#include <deque>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Heuristic solver for instances far beyond the exact search (--solver=heuristic).
+// Coordinate instances keep only their coordinates and each city's
+// HEURISTIC_CANDIDATES nearest neighbors, so memory is O(n k) instead of O(n^2).
+// Every worker (thread or rank) starts from its own nearest-neighbor tour, improves
+// it with Lin-Kernighan style chains of 2-opt moves and Or-opt segment insertions
+// driven by don't-look bits, then keeps kicking it with a double bridge and
+// re-optimizing, keeping a kick only if the tour gets shorter (chained Lin-Kernighan).
+// Moves reverse paths of an array tour, so the instance must be symmetric.
+
+const int HEURISTIC_CANDIDATES = 10;
+// Longest segment moved by Or-opt
+const int OR_OPT_MAX_SEGMENT = 3;
+// Longest segment a double bridge kick moves; kicks stay local so undoing them is cheap
+const int KICK_MAX_SEGMENT = 50;
+
+// k nearest other cities of every city, row by row, nearest first. Costs O(n^2)
+// distance evaluations but only O(n k) memory.
+void build_candidate_lists(const TspInstance &instance, int count, std::vector<int> &candidates)
+{
+    const int n = instance.num_cities;
+    candidates.assign((size_t)n * count, 0);
+#pragma omp parallel
+    {
+        std::vector<std::pair<int, int>> row;
+#pragma omp for schedule(dynamic, 16)
+        for (int i = 0; i < n; i++)
+        {
+            row.clear();
+            for (int j = 0; j < n; j++)
+            {
+                if (j != i)
+                    row.push_back(std::make_pair(instance_distance(instance, i, j), j));
+            }
+            std::partial_sort(row.begin(), row.begin() + count, row.end());
+            for (int k = 0; k < count; k++)
+            {
+                candidates[(size_t)i * count + k] = row[k].second;
+            }
+        }
+    }
+}
+
+// HEURISTIC_CANDIDATES entries of every row of `lists`, whose row i holds `count`
+// cities nearest first from index i * stride. Short rows repeat their farthest city.
+void copy_candidate_lists(const std::vector<int> &lists, int num_cities, int stride, int count,
+                          std::vector<int> &candidates)
+{
+    candidates.assign((size_t)num_cities * HEURISTIC_CANDIDATES, 0);
+    for (int i = 0; i < num_cities; i++)
+    {
+        for (int k = 0; k < HEURISTIC_CANDIDATES; k++)
+            candidates[(size_t)i * HEURISTIC_CANDIDATES + k] = lists[(size_t)i * stride + std::max(0, std::min(k, count - 1))];
+    }
+}
+
+// Array tour: order[k] is the k-th city and position[c] the index of city c. Every
+// reversal is journaled, so a rejected kick is rolled back in time proportional to
+// the work it caused rather than to the tour length.
+struct ArrayTour
+{
+    std::vector<int> order;
+    std::vector<int> position;
+    std::vector<std::pair<int, int>> journal; // (first position, length) of each reversal
+};
+
+void init_array_tour(ArrayTour &tour, const std::vector<int> &order)
+{
+    tour.order = order;
+    tour.position.resize(order.size());
+    for (int k = 0; k < (int)order.size(); k++)
+        tour.position[order[k]] = k;
+    tour.journal.clear();
+}
+
+inline int tour_next(const ArrayTour &tour, int city)
+{
+    int k = tour.position[city] + 1;
+    return tour.order[k == (int)tour.order.size() ? 0 : k];
+}
+
+inline int tour_prev(const ArrayTour &tour, int city)
+{
+    int k = tour.position[city];
+    return tour.order[k == 0 ? tour.order.size() - 1 : k - 1];
+}
+
+inline int tour_step(const ArrayTour &tour, int city, bool forward)
+{
+    return forward ? tour_next(tour, city) : tour_prev(tour, city);
+}
+
+long long array_tour_length(const TspInstance &instance, const ArrayTour &tour)
+{
+    long long total = 0;
+    for (int city : tour.order)
+        total += instance_distance(instance, city, tour_next(tour, city));
+    return total;
+}
+
+// Reverses `length` cities starting at position `first`, wrapping around the end
+void reverse_positions(ArrayTour &tour, int first, int length)
+{
+    const int n = tour.order.size();
+    int i = first, j = first + length - 1;
+    if (j >= n)
+        j -= n;
+    for (int s = 0; s < length / 2; s++)
+    {
+        int a = tour.order[i], b = tour.order[j];
+        tour.order[i] = b;
+        tour.position[b] = i;
+        tour.order[j] = a;
+        tour.position[a] = j;
+        if (++i == n)
+            i = 0;
+        if (--j < 0)
+            j = n - 1;
+    }
+    tour.journal.push_back(std::make_pair(first, length));
+}
+
+// Undoes the reversals journaled after `mark`
+void tour_rollback(ArrayTour &tour, size_t mark)
+{
+    while (tour.journal.size() > mark)
+    {
+        std::pair<int, int> reversal = tour.journal.back();
+        reverse_positions(tour, reversal.first, reversal.second);
+        tour.journal.resize(tour.journal.size() - 2);
+    }
+}
+
+// Replaces edges (a, b) and (c, d) by (a, c) and (b, d). Walking from a towards b
+// must reach c before d. Either of the two paths between the new edges may be
+// reversed; the shorter one is.
+void two_opt_move(ArrayTour &tour, int a, int b, int c, int d)
+{
+    const int n = tour.order.size();
+    if (tour_next(tour, a) != b)
+    {
+        // Walking backwards; the same move seen forwards
+        std::swap(a, d);
+        std::swap(b, c);
+    }
+    int first = tour.position[b];
+    int length = tour.position[c] - first;
+    if (length < 0)
+        length += n;
+    length++;
+    if (2 * length <= n)
+        reverse_positions(tour, first, length);
+    else
+        reverse_positions(tour, tour.position[d], n - length);
+}
+
+// Don't-look bits: only cities in `active` are tried as move starts. A city leaves
+// the queue when no move from it improves and comes back when an edge at it changes.
+struct LocalSearch
+{
+    std::deque<int> active;
+    std::vector<char> queued;
+    std::vector<int> touched; // Cities whose edges the last move changed
+};
+
+inline void activate(LocalSearch &search, int city)
+{
+    if (!search.queued[city])
+    {
+        search.queued[city] = 1;
+        search.active.push_back(city);
+    }
+}
+
+// Starts with every city of the tour active
+void init_local_search(LocalSearch &search, const ArrayTour &tour)
+{
+    search.active.clear();
+    search.queued.assign(tour.order.size(), 0);
+    for (int city : tour.order)
+        activate(search, city);
+}
+
+// Alternatives tried for the move at each depth of a Lin-Kernighan chain; deeper
+// moves take only the best one
+const int LK_BREADTH[] = {5, 3, 1, 1, 1, 1, 1, 1, 1, 1};
+const int LK_MAX_DEPTH = sizeof(LK_BREADTH) / sizeof(LK_BREADTH[0]);
+
+struct LkMove
+{
+    int score; // Gain of breaking (t3, t4) less the cost of adding (t2, t3)
+    int t3, t4;
+};
+
+// Continues a Lin-Kernighan chain whose open end is (t1, t2): tries the best
+// LK_BREADTH[depth] 2-opt moves that add (t2, t3) and break (t3, t4), each followed
+// by the rest of the chain. The first chain that closes with a gain is kept, cut at
+// its most profitable move. Returns that gain; 0 leaves the tour unchanged.
+int lin_kernighan_chain(const TspInstance &instance, const std::vector<int> &candidates, ArrayTour &tour, int t1,
+                        int t2, int gain, int depth, int added[][2], LocalSearch &search)
+{
+    if (depth == LK_MAX_DEPTH)
+        return 0;
+    bool forward = tour_next(tour, t1) == t2;
+    LkMove moves[HEURISTIC_CANDIDATES];
+    int count = 0;
+    const int *row = &candidates[(size_t)t2 * HEURISTIC_CANDIDATES];
+    for (int k = 0; k < HEURISTIC_CANDIDATES; k++)
+    {
+        int c = row[k];
+        int d_t2c = instance_distance(instance, t2, c);
+        if (gain - d_t2c <= 0)
+            break; // Candidates come nearest first
+        int d = tour_step(tour, c, !forward);
+        if (c == t1 || d == t2 || (k > 0 && c == row[k - 1]))
+            continue;
+        bool readded = false;
+        for (int e = 0; e < depth; e++)
+        {
+            readded = readded || (added[e][0] == c && added[e][1] == d) || (added[e][0] == d && added[e][1] == c);
+        }
+        if (!readded)
+            moves[count++] = {instance_distance(instance, c, d) - d_t2c, c, d};
+    }
+    int breadth = std::min(count, LK_BREADTH[depth]);
+    std::partial_sort(moves, moves + breadth, moves + count,
+                      [](const LkMove &a, const LkMove &b) { return a.score > b.score; });
+
+    for (int i = 0; i < breadth; i++)
+    {
+        int t3 = moves[i].t3, t4 = moves[i].t4;
+        size_t mark = tour.journal.size();
+        size_t touched = search.touched.size();
+        two_opt_move(tour, t1, t2, t4, t3);
+        added[depth][0] = t2;
+        added[depth][1] = t3;
+        search.touched.push_back(t2);
+        search.touched.push_back(t3);
+        search.touched.push_back(t4);
+
+        int extended = gain + moves[i].score;
+        int closed = extended - instance_distance(instance, t4, t1);
+        size_t closed_mark = tour.journal.size();
+        size_t closed_touched = search.touched.size();
+        int deeper = lin_kernighan_chain(instance, candidates, tour, t1, t4, extended, depth + 1, added, search);
+        if (deeper > 0 && deeper > closed)
+            return deeper;
+        if (closed > 0)
+        {
+            tour_rollback(tour, closed_mark);
+            search.touched.resize(closed_touched);
+            return closed;
+        }
+        tour_rollback(tour, mark);
+        search.touched.resize(touched);
+    }
+    return 0;
+}
+
+// One Lin-Kernighan step from t1, breaking either of its tour edges first. Returns
+// the gain, 0 if the tour is unchanged.
+int lin_kernighan_step(const TspInstance &instance, const std::vector<int> &candidates, ArrayTour &tour, int t1,
+                       LocalSearch &search)
+{
+    int added[LK_MAX_DEPTH][2];
+    for (int side = 0; side < 2; side++)
+    {
+        int t2 = tour_step(tour, t1, side == 0);
+        search.touched.assign(1, t1);
+        int gain = lin_kernighan_chain(instance, candidates, tour, t1, t2, instance_distance(instance, t1, t2), 0,
+                                       added, search);
+        if (gain > 0)
+            return gain;
+    }
+    return 0;
+}
+
+// Or-opt from s1: moves the segment of 1..OR_OPT_MAX_SEGMENT cities starting at s1,
+// in either direction, between two adjacent cities near one of its ends, reversed or
+// not (a 3-opt move done as two or three 2-opt moves). Returns the gain, 0 if none.
+int or_opt_step(const TspInstance &instance, const std::vector<int> &candidates, ArrayTour &tour, int s1,
+                LocalSearch &search)
+{
+    const int n = tour.order.size();
+    for (int side = 0; side < 2; side++)
+    {
+        const bool forward = side == 0;
+        int s2 = s1;
+        for (int length = 1; length <= OR_OPT_MAX_SEGMENT && length + 3 < n; length++)
+        {
+            if (length > 1)
+                s2 = tour_step(tour, s2, forward);
+            int p = tour_step(tour, s1, !forward), q = tour_step(tour, s2, forward);
+            int removed = instance_distance(instance, p, s1) + instance_distance(instance, s2, q) -
+                          instance_distance(instance, p, q);
+            if (removed <= 0)
+                continue;
+
+            for (int end = 0; end < 2; end++)
+            {
+                int e = end == 0 ? s1 : s2;
+                const int *row = &candidates[(size_t)e * HEURISTIC_CANDIDATES];
+                for (int k = 0; k < HEURISTIC_CANDIDATES; k++)
+                {
+                    int c = row[k];
+                    if (instance_distance(instance, e, c) >= removed)
+                        break;
+                    for (int edge = 0; edge < 2; edge++)
+                    {
+                        // Edge (u, v) with v after u when walking from p through the segment
+                        int u = edge == 0 ? c : tour_step(tour, c, !forward);
+                        int v = edge == 0 ? tour_step(tour, c, forward) : c;
+                        int offset_u = forward ? tour.position[u] - tour.position[p] : tour.position[p] - tour.position[u];
+                        if (offset_u < 0)
+                            offset_u += n;
+                        if (offset_u <= length + 1 || offset_u == n - 1)
+                            continue; // The edge touches p, the segment or q
+                        int kept = instance_distance(instance, u, s2) + instance_distance(instance, s1, v);
+                        int turned = instance_distance(instance, u, s1) + instance_distance(instance, s2, v);
+                        int gain = removed + instance_distance(instance, u, v) - std::min(kept, turned);
+                        if (gain <= 0)
+                            continue;
+
+                        two_opt_move(tour, p, s1, u, v);
+                        two_opt_move(tour, p, u, q, s2);
+                        if (turned < kept)
+                            two_opt_move(tour, u, s2, s1, v);
+                        search.touched.assign({p, q, s1, s2, u, v});
+                        return gain;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// Applies moves until no active city has an improving one. Returns the total gain.
+long long improve_array_tour(const TspInstance &instance, const std::vector<int> &candidates, ArrayTour &tour,
+                             LocalSearch &search)
+{
+    long long total = 0;
+    while (!search.active.empty())
+    {
+        int city = search.active.front();
+        search.active.pop_front();
+        search.queued[city] = 0;
+        int gain = lin_kernighan_step(instance, candidates, tour, city, search);
+        if (gain == 0)
+            gain = or_opt_step(instance, candidates, tour, city, search);
+        if (gain > 0)
+        {
+            total += gain;
+            activate(search, city);
+            for (int touched : search.touched)
+                activate(search, touched);
+        }
+    }
+    return total;
+}
+
+// Double bridge kick: swaps two short adjacent segments at a random place, as three
+// reversals. Returns the change in length and activates the cities it touched.
+long long double_bridge_kick(const TspInstance &instance, ArrayTour &tour, LocalSearch &search, std::mt19937 &rng)
+{
+    const int n = tour.order.size();
+    int longest = std::min(KICK_MAX_SEGMENT, (n - 2) / 2);
+    int first = rng() % n;
+    int length_a = 1 + rng() % longest, length_b = 1 + rng() % longest;
+    int p = tour.order[first];
+    int a1 = tour.order[(first + 1) % n], a2 = tour.order[(first + length_a) % n];
+    int b1 = tour.order[(first + length_a + 1) % n], b2 = tour.order[(first + length_a + length_b) % n];
+    int q = tour.order[(first + length_a + length_b + 1) % n];
+    long long delta = (long long)instance_distance(instance, p, b1) + instance_distance(instance, b2, a1) +
+                      instance_distance(instance, a2, q) - instance_distance(instance, p, a1) -
+                      instance_distance(instance, a2, b1) - instance_distance(instance, b2, q);
+
+    int start = (first + 1) % n;
+    reverse_positions(tour, start, length_a + length_b);
+    reverse_positions(tour, start, length_b);
+    reverse_positions(tour, (start + length_b) % n, length_a);
+    for (int city : {p, a1, a2, b1, b2, q})
+        activate(search, city);
+    return delta;
+}
+
+// Nearest-neighbor tour over the candidate lists, falling back to a scan of the
+// unvisited cities when every candidate is taken
+std::vector<int> nearest_neighbor_tour(const TspInstance &instance, const std::vector<int> &candidates, int start)
+{
+    const int n = instance.num_cities;
+    std::vector<int> unvisited(n), slot(n), tour;
+    std::iota(unvisited.begin(), unvisited.end(), 0);
+    std::iota(slot.begin(), slot.end(), 0);
+    tour.reserve(n);
+    int city = start;
+    while (true)
+    {
+        // Remove `city` from the unvisited list
+        int moved = unvisited.back();
+        unvisited[slot[city]] = moved;
+        slot[moved] = slot[city];
+        unvisited.pop_back();
+        slot[city] = -1;
+        tour.push_back(city);
+        if (unvisited.empty())
+            break;
+
+        int next = -1;
+        for (int k = 0; k < HEURISTIC_CANDIDATES && next < 0; k++)
+        {
+            int c = candidates[(size_t)city * HEURISTIC_CANDIDATES + k];
+            if (slot[c] >= 0)
+                next = c;
+        }
+        if (next < 0)
+        {
+            int best = INT_MAX;
+            for (int other : unvisited)
+            {
+                int distance = instance_distance(instance, city, other);
+                if (distance < best)
+                {
+                    best = distance;
+                    next = other;
+                }
+            }
+        }
+        city = next;
+    }
+    return tour;
+}
+
+// One worker of the multi-start: a nearest-neighbor tour from a random city, local
+// search, then `kicks` double bridge kicks (until the time limit, if there is one).
+// Tours better than the process's best go to `incumbent` and are streamed.
+void chained_lin_kernighan(const TspInstance &instance, const std::vector<int> &candidates, unsigned int seed,
+                           long long kicks, AnytimeLimits &limits, Incumbent &incumbent)
+{
+    const int n = instance.num_cities;
+    std::mt19937 rng(seed);
+    ArrayTour tour;
+    init_array_tour(tour, nearest_neighbor_tour(instance, candidates, rng() % n));
+    LocalSearch search;
+    init_local_search(search, tour);
+
+    long long length = array_tour_length(instance, tour) - improve_array_tour(instance, candidates, tour, search);
+    tour.journal.clear();
+    for (long long kick = 0;; kick++)
+    {
+        if (length < incumbent_distance(incumbent) && incumbent_offer(incumbent, (int)length, tour.order.data(), n))
+            anytime_publish(limits, (int)length, tour.order.data(), n);
+        // With a time limit, kick until it is reached
+        bool stop = limits.deadline > 0 ? anytime_poll(limits) : kick == kicks || anytime_stopped(limits);
+        if (stop || n < 8)
+            break;
+
+        long long kicked = length + double_bridge_kick(instance, tour, search, rng);
+        kicked -= improve_array_tour(instance, candidates, tour, search);
+        if (kicked < length)
+            length = kicked;
+        else
+            tour_rollback(tour, 0);
+        tour.journal.clear();
+    }
+}
+
+// Best tour over `team_size` workers of this process, run by its OpenMP team. Workers
+// are numbered first, first + stride, ... so MPI ranks passing their rank and size
+// all start differently. The tour is rotated to begin at start_city.
+std::pair<std::vector<int>, int> heuristic_tour(const TspInstance &instance, int start_city, int first, int stride,
+                                                int team_size, unsigned int seed, AnytimeLimits &limits)
+{
+    const int n = instance.num_cities;
+    std::vector<int> candidates;
+    build_candidate_lists(instance, std::min(HEURISTIC_CANDIDATES, n - 1), candidates);
+    if (n - 1 < HEURISTIC_CANDIDATES)
+    {
+        std::vector<int> padded;
+        copy_candidate_lists(candidates, n, n - 1, n - 1, padded);
+        candidates.swap(padded);
+    }
+
+    Incumbent incumbent;
+    init_incumbent(incumbent, std::make_pair(std::vector<int>(), INT_MAX), n);
+#pragma omp parallel for schedule(dynamic)
+    for (int w = 0; w < team_size; w++)
+    {
+        int worker = first + w * stride;
+        chained_lin_kernighan(instance, candidates, seed + 0x9E3779B9u * (worker + 1), n, limits, incumbent);
+    }
+
+    std::vector<int> best_tour;
+    int best_distance = incumbent_read(incumbent, best_tour);
+    std::rotate(best_tour.begin(), std::find(best_tour.begin(), best_tour.end(), start_city), best_tour.end());
+    return {best_tour, best_distance};
+}
+
+// The heuristic's moves assume d(i, j) == d(j, i)
+bool heuristic_supported(const TspInstance &instance)
+{
+    if (instance.num_cities < 3 ||
+        (!instance.distances.empty() && !is_symmetric(instance.distances, instance.num_cities)))
+    {
+        std::cerr << "Error: The heuristic solver needs a symmetric instance of at least 3 cities." << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,153 @@
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Dominance memo: the cheapest partial path seen so far for each (visited set, last
+// city). Another path with the same visited set and end that costs at least as much
+// can only complete into tours that are no better, so its subtree is skipped; this is
+// Held-Karp's recurrence used as a pruning rule, in a fixed amount of memory.
+//
+// The table is shared by all threads of a process. A bucket is one cache line: a
+// sequence word and MEMO_WAYS entries. Readers never wait; they retry nothing and
+// treat a bucket that changed under them as a miss. Writers take the bucket with a
+// compare-and-swap and simply drop the store if another thread holds it.
+
+const int MEMO_WAYS = 3;
+const int MEMO_BUCKET_WORDS = 8; // Sequence word, MEMO_WAYS (mask, value) pairs, padding
+const int MEMO_DEFAULT_MEGABYTES = 16;
+// Subtrees with fewer unvisited cities are cheaper to search than to look up
+const int MEMO_MIN_REMAINING = 6;
+// Shorter paths have no other ordering of their inner cities to be compared with
+const int MEMO_MIN_LENGTH = 4;
+
+enum MemoCounter
+{
+    MEMO_PROBES,    // Paths looked up
+    MEMO_HITS,      // Same visited set and last city found
+    MEMO_DOMINATED, // Hits that pruned the path
+    MEMO_STORED,    // Paths recorded
+    MEMO_EVICTED,   // Stores that replaced another key
+    MEMO_BUSY,      // Stores dropped because another thread held the bucket
+    MEMO_COUNTERS
+};
+
+const char *const MEMO_COUNTER_NAMES[MEMO_COUNTERS] = {"probes", "hits", "dominated", "stored", "evicted", "busy"};
+
+// Value word of an entry: cost in bits 0-31, last city in 32-37, second city + 1 in
+// 38-44 (0 when orientation is not restricted), bit 63 set for a used entry
+const uint64_t MEMO_USED = (uint64_t)1 << 63;
+
+struct DominanceMemo
+{
+    std::vector<std::atomic<uint64_t>> words; // Empty if the memo is disabled
+    uint64_t bucket_mask = 0;                 // Number of buckets - 1, a power of two
+};
+
+// Allocates the largest power-of-two number of buckets that fits in `megabytes`
+void init_memo(DominanceMemo &memo, int megabytes)
+{
+    uint64_t bytes = (uint64_t)megabytes << 20;
+    uint64_t buckets = 1;
+    while (buckets * 2 * MEMO_BUCKET_WORDS * sizeof(uint64_t) <= bytes)
+        buckets *= 2;
+    if (buckets * MEMO_BUCKET_WORDS * sizeof(uint64_t) > bytes)
+        return;
+    memo.bucket_mask = buckets - 1;
+    std::vector<std::atomic<uint64_t>>(buckets * MEMO_BUCKET_WORDS).swap(memo.words);
+}
+
+// Forgets every stored path, so the table can serve another instance
+void memo_clear(DominanceMemo &memo)
+{
+    for (std::atomic<uint64_t> &word : memo.words)
+        word.store(0, std::memory_order_relaxed);
+}
+
+inline uint64_t memo_hash(uint64_t visited, int last)
+{
+    // splitmix64 finalizer
+    uint64_t h = visited ^ ((uint64_t)(last + 1) * 0x9E3779B97F4A7C15ULL);
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+// Looks up the path ending at `last` with the given visited set and cost; `second` is
+// its second city, or -1 if all orientations are searched. Returns true if a stored
+// path dominates it: no more expensive, and allowed every end city this one is.
+// Otherwise records it, replacing its own key if cheaper or else the entry guarding
+// the smallest subtree.
+bool memo_dominated(DominanceMemo &memo, uint64_t visited, int last, int second, int cost, long long *counters)
+{
+    counters[MEMO_PROBES]++;
+    std::atomic<uint64_t> *bucket = &memo.words[(memo_hash(visited, last) & memo.bucket_mask) * MEMO_BUCKET_WORDS];
+    const uint64_t tag = ((uint64_t)last << 32) | ((uint64_t)(second + 1) << 38);
+    const uint64_t tag_bits = ((uint64_t)0x3F << 32) | MEMO_USED;
+
+    uint64_t version = bucket[0].load(std::memory_order_acquire);
+    uint64_t masks[MEMO_WAYS], values[MEMO_WAYS];
+    for (int w = 0; w < MEMO_WAYS; w++)
+    {
+        masks[w] = bucket[1 + 2 * w].load(std::memory_order_relaxed);
+        values[w] = bucket[2 + 2 * w].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    bool consistent = (version & 1) == 0 && bucket[0].load(std::memory_order_relaxed) == version;
+
+    // The entry for this key, if any, else a free one, else the one guarding the
+    // smallest subtree (the most cities visited)
+    const int FREE = 65;
+    int slot = -1;
+    int victim = 0;
+    int victim_visited = -1;
+    for (int w = 0; consistent && w < MEMO_WAYS; w++)
+    {
+        if (!(values[w] & MEMO_USED))
+        {
+            victim = w;
+            victim_visited = FREE;
+            continue;
+        }
+        if (masks[w] == visited && (values[w] & tag_bits) == ((tag & tag_bits) | MEMO_USED))
+        {
+            slot = w;
+            break;
+        }
+        int count = __builtin_popcountll(masks[w]);
+        if (count > victim_visited)
+        {
+            victim = w;
+            victim_visited = count;
+        }
+    }
+    if (slot >= 0)
+    {
+        counters[MEMO_HITS]++;
+        int stored_cost = (int)(uint32_t)values[slot];
+        int stored_second = (int)((values[slot] >> 38) & 0x7F) - 1;
+        if (stored_cost <= cost && stored_second <= second)
+        {
+            counters[MEMO_DOMINATED]++;
+            return true;
+        }
+        if (stored_cost <= cost)
+            return false; // Incomparable; keep the cheaper path
+        victim = slot;
+    }
+
+    // Store under the bucket's sequence word; give up if another thread holds it
+    if (!consistent ||
+        !bucket[0].compare_exchange_strong(version, version + 1, std::memory_order_acquire, std::memory_order_relaxed))
+    {
+        counters[MEMO_BUSY]++;
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    bucket[1 + 2 * victim].store(visited, std::memory_order_relaxed);
+    bucket[2 + 2 * victim].store(tag | (uint32_t)cost | MEMO_USED, std::memory_order_relaxed);
+    bucket[0].store(version + 2, std::memory_order_release);
+    counters[MEMO_STORED]++;
+    if (slot < 0 && victim_visited != FREE)
+        counters[MEMO_EVICTED]++;
+    return false;
+}
@@ -5,11 +5,13 @@
 #include <unistd.h>
 #include <mpi.h>
 #include "utils.h"
+#include "mpi_scheduler.cpp"
 
 int min_distance = INT_MAX;
 std::vector<int> min_path;
 
 std::vector<int> distances;
+std::vector<int> neighbors;
 int num_cities;
 
 int main(int argc, char *argv[])
@@ -20,32 +22,23 @@ int main(int argc, char *argv[])
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
     double start_time, end_time, global_start_time, global_end_time;
-    global_start_time = MPI_Wtime();
-    start_time = MPI_Wtime();
+    global_start_time = trace_clock();
+    start_time = trace_clock();
 
-    std::string input_filename;
-    std::string logs_filename;
-    if (argc == 3)
-    {
-        input_filename = argv[1];
-        logs_filename = argv[2];
-    }
-    else
+    SolverOptions options;
+    if (!parse_options(argc, argv, options))
     {
         if (rank == 0)
         {
-            std::cout << "Usage: " << argv[0] << " <input_data_filename> <logs_filename>" << std::endl;
+            print_usage(argv[0]);
         }
         MPI_Finalize();
         return 0;
     }
-
-    // Clear logs file (only on rank 0)
-    if (rank == 0)
-    {
-        std::ofstream logs_file(logs_filename, std::ios::out);
-        logs_file.close();
-    }
+    AnytimeLimits limits;
+    anytime_init(limits, options.time_limit, options.gap);
+    std::string input_filename = options.input_filename;
+    std::string logs_filename = options.logs_filename;
 
     // Get hostname
     std::string hostname;
@@ -61,171 +54,321 @@ int main(int argc, char *argv[])
         hostname = "Unknown";
     }
 
-    // Setup: read input file (all processes read the file)
-    num_cities = read_tsplib_matrix(input_filename, distances);
+    // Buffer phase events per thread; only rank 0 clears the logs file
+    trace_init(logs_filename, hostname, options.trace_format, options.trace_sample, rank == 0);
+    stats_init(options.stats, rank);
+    MPI_Barrier(MPI_COMM_WORLD);
 
-    // Set starting city
-    int first_city = 0;
-
-    // Create all possible pre-paths to be explored and shuffle them
-    std::vector<std::vector<int>> paths;
-    create_paths(paths, first_city, num_cities);
+    // Batch mode: rank 0 deals instance files to the other ranks, which solve them one
+    // at a time and send back the result lines
+    if (options.batch)
+    {
+        int status = 0;
+        if (size == 1)
+        {
+            status = batch_run(options, 1, rank);
+        }
+        else if (rank == 0)
+        {
+            status = batch_coordinate(options, size - 1);
+        }
+        else
+        {
+            BatchWorkspace workspace;
+            std::string results, filename;
+            while (batch_request(results, filename))
+            {
+                results += batch_solve(workspace, filename, options, 1) + "\n";
+                trace_event(TRACE_COMPUTATION, rank, workspace.start_time, batch_clock());
+            }
+            batch_finish(results);
+        }
+        trace_finish();
+        MPI_Finalize();
+        return status;
+    }
 
-    // Only rank 0 shuffles the paths
+    // Setup: rank 0 reads the input file and draws the shuffle seed
+    unsigned int seed = 0;
+    TspInstance instance;
     if (rank == 0)
     {
+        if (options.solver == SOLVER_HEURISTIC)
+        {
+            num_cities = read_tsplib_instance(input_filename, instance, true);
+            if (num_cities > 0 && !heuristic_supported(instance))
+            {
+                num_cities = 0;
+            }
+        }
+        else
+        {
+            num_cities = read_tsplib_matrix(input_filename, distances, solver_cities_supported(options.solver));
+        }
         std::random_device rd;
-        std::mt19937 gen(rd());
-        std::shuffle(paths.begin(), paths.end(), gen);
+        seed = rd();
     }
-    end_time = MPI_Wtime();
-    log_event(logs_filename, "SETUP", hostname, rank, start_time, end_time);
-
-    // Broadcast the shuffled paths to all processes
-    start_time = MPI_Wtime();
-    int paths_size = paths.size();
-    MPI_Bcast(&paths_size, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    end_time = trace_clock();
+    trace_event(TRACE_SETUP, rank, start_time, end_time);
 
-    if (rank != 0)
+    // Share the matrix and the seed; this is the only startup traffic
+    start_time = trace_clock();
+    MPI_Bcast(&num_cities, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (num_cities == 0)
     {
-        paths.resize(paths_size);
+        MPI_Finalize();
+        return 1;
     }
-
-    for (int i = 0; i < paths_size; i++)
+    if (options.solver == SOLVER_HEURISTIC)
+    {
+        broadcast_instance(instance, num_cities);
+    }
+    else
     {
-        int path_size = paths[i].size();
-        MPI_Bcast(&path_size, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        distances.resize(num_cities * num_cities);
+        MPI_Bcast(distances.data(), num_cities * num_cities, MPI_INT, 0, MPI_COMM_WORLD);
+    }
+    MPI_Bcast(&seed, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+    end_time = trace_clock();
+    trace_event(TRACE_COMMUNICATION, rank, start_time, end_time);
 
-        if (rank != 0)
+    // Set starting city
+    int first_city = 0;
+
+    // Enumerate the pre-paths to be explored lazily. Every rank derives the same
+    // order from the shared seed, so chunks are just index ranges.
+    start_time = trace_clock();
+    PrefixEnumerator prefixes;
+    if (options.solver == SOLVER_BRANCH_AND_BOUND)
+    {
+        if (!init_prefixes(prefixes, num_cities, first_city, options.prefix_depth, size > 1 ? size - 1 : 1, seed,
+                           options.prefix_order == ORDER_BOUND))
         {
-            paths[i].resize(path_size);
+            MPI_Finalize();
+            return 1;
         }
-
-        MPI_Bcast(paths[i].data(), path_size, MPI_INT, 0, MPI_COMM_WORLD);
     }
 
-    end_time = MPI_Wtime();
-    log_event(logs_filename, "COMMUNICATION", hostname, rank, start_time, end_time);
-
-    // Generate initial solution on all processes
-    start_time = MPI_Wtime();
-    std::pair<std::vector<int>, int> result = nearest_neighbor_tsp(distances, num_cities);
-    std::vector<int> initial_path = result.first;
-    int initial_distance = result.second;
-    int local_min_distance = initial_distance;
-    std::vector<int> local_min_path = initial_path;
-    end_time = MPI_Wtime();
-    log_event(logs_filename, "COMPUTATION", hostname, rank, start_time, end_time);
-
-    // Distribute paths among processes
-    start_time = MPI_Wtime();
-    int paths_per_process = paths.size() / size;
-    int start_index = rank * paths_per_process;
-    int end_index = (rank == size - 1) ? paths.size() : (rank + 1) * paths_per_process;
-    end_time = MPI_Wtime();
-    log_event(logs_filename, "ORCHESTRATION", hostname, rank, start_time, end_time);
-
-    // Explore assigned paths
-    int paths_processed = 0;
-    int current_sync_period = INITIAL_SYNC_PERIOD;
-    int paths_since_last_sync = 0;
-
-    for (int i = start_index; i < end_index; i++)
+    // Resume from the checkpoint of an earlier job, if there is one, then rank the
+    // prefixes if they go in bound order
+    Checkpoint checkpoint;
+    if (options.solver == SOLVER_BRANCH_AND_BOUND &&
+        (!checkpoint_broadcast(checkpoint, prefixes, options, distances, num_cities, rank) ||
+         !order_prefixes_by_bound(prefixes, distances)))
     {
-        start_time = MPI_Wtime();
-
-        std::vector<int> path = paths[i];
-        std::vector<int> visited(num_cities, false);
-        int curr_distance = 0;
+        MPI_Finalize();
+        return 1;
+    }
+    end_time = trace_clock();
+    trace_event(TRACE_SETUP, rank, start_time, end_time);
 
-        // Initialize the curr-distance and visited vector for the current pre-path
-        for (int j = 0; j < (int)path.size(); j++)
+    if (options.solver == SOLVER_HELD_KARP)
+    {
+        // The DP table is too large to replicate per rank, so rank 0 solves it alone
+        if (rank == 0)
+        {
+            start_time = trace_clock();
+            std::pair<std::vector<int>, int> result = held_karp_tsp(distances, num_cities);
+            min_path = result.first;
+            min_distance = result.second;
+            end_time = trace_clock();
+            trace_event(TRACE_COMPUTATION, rank, start_time, end_time);
+        }
+    }
+    else if (options.solver == SOLVER_HEURISTIC)
+    {
+        // Every rank runs its own chained Lin-Kernighan workers, then all take the best tour
+        start_time = trace_clock();
+        std::pair<std::vector<int>, int> result = heuristic_tour(instance, first_city, rank, size, 1, seed, limits);
+        end_time = trace_clock();
+        trace_event(TRACE_COMPUTATION, rank, start_time, end_time);
+
+        start_time = trace_clock();
+        best_tour_of_ranks(result, num_cities);
+        min_path = result.first;
+        min_distance = result.second;
+        end_time = trace_clock();
+        trace_event(TRACE_COMMUNICATION, rank, start_time, end_time);
+    }
+    else
+    {
+        // Each process improves tours from its share of the start cities, then all
+        // start from the best bound
+        start_time = trace_clock();
+        build_neighbor_lists(distances, num_cities, neighbors);
+        std::pair<std::vector<int>, int> result = initial_tour(distances, neighbors, num_cities, first_city, rank, size);
+        checkpoint_seed_tour(checkpoint, result);
+        struct
+        {
+            int distance;
+            int rank;
+        } initial = {result.second, rank};
+        MPI_Allreduce(MPI_IN_PLACE, &initial, 1, MPI_2INT, MPI_MINLOC, MPI_COMM_WORLD);
+        LowerBound bound;
+        init_lower_bound(bound, options.bound, distances, num_cities, first_city);
+        Incumbent incumbent;
+        init_incumbent(incumbent, result, num_cities);
+        incumbent_lower(incumbent, initial.distance);
+        DominanceMemo memo;
+        init_memo(memo, options.memo_megabytes);
+        SearchContext search;
+        init_search(search, distances, neighbors, num_cities, bound, incumbent);
+        attach_memo(search, memo);
+        attach_limits(search, limits);
+
+        // Only rank 0 learns which prefixes are finished, so only it can check the gap;
+        // the other ranks stop when it tells them to
+        anytime_attach(limits, prefixes, bound, distances, incumbent, checkpoint);
+        if (rank != 0)
+        {
+            limits.gap = -1;
+        }
+        if (rank == initial.rank)
+        {
+            anytime_publish(limits, result.second, result.first.data(), num_cities);
+        }
+        SearchPrefixFn search_prefix = search_prefix_for(num_cities);
+        if (search_prefix == nullptr)
+        {
+            MPI_Finalize();
+            return 1;
+        }
+        end_time = trace_clock();
+        trace_event(TRACE_COMPUTATION, rank, start_time, end_time);
+
+        // Expose the global bound for one-sided updates
+        start_time = trace_clock();
+        SharedBound shared_bound;
+        shared_bound_create(shared_bound, incumbent_distance(incumbent), limits, rank);
+        end_time = trace_clock();
+        trace_event(TRACE_COMMUNICATION, rank, start_time, end_time);
+
+        stats_begin_search();
+        if (size > 1 && rank == 0)
+        {
+            // Rank 0 only hands out chunks of prefixes and relays the best bound
+            WorkPool pool = {0, (int)prefixes.count, &prefixes};
+            coordinate_work(pool, size - 1, incumbent, shared_bound, checkpoint, rank);
+        }
+        else
         {
-            if (j < (int)path.size() - 1)
+            // A single process explores everything; otherwise ask rank 0 for chunks
+            WorkChunk chunk = {0, (int)prefixes.count};
+            std::vector<WorkChunk> finished;
+            bool has_work = true;
+            int prefix[KERNEL_MAX_CITIES];
+            std::vector<SavedStack> stacks;
+            if (size > 1)
             {
-                curr_distance += get_distance(path[j], path[j + 1], distances, num_cities);
+                start_time = trace_clock();
+                has_work = request_work(incumbent, chunk, finished);
+                end_time = trace_clock();
+                trace_event(TRACE_COMMUNICATION, rank, start_time, end_time);
             }
-            visited[path[j]] = true;
-        }
-
-        // Use local_min_distance as the initial upper bound
-        dfs(path, visited, curr_distance, local_min_distance, local_min_path, distances, num_cities);
-
-        end_time = MPI_Wtime();
-        log_event(logs_filename, "COMPUTATION", hostname, rank, start_time, end_time);
 
-        paths_processed++;
-
-        paths_since_last_sync++;
+            while (has_work)
+            {
+                int i;
+                for (i = chunk.start; i < chunk.start + chunk.count && !anytime_stopped(limits); i++)
+                {
+                    if (checkpoint_done(checkpoint, i) ||
+                        drop_hopeless_prefix(prefixes, i, incumbent, checkpoint, limits))
+                    {
+                        continue;
+                    }
+                    start_time = trace_clock();
+
+                    // Use the local minimum distance as the initial upper bound
+                    int prefix_length = prefix_at(prefixes, i, prefix);
+                    checkpoint_stacks(checkpoint, i, stacks);
+                    search_prefix(search, prefix, prefix_length, &stacks);
+                    if (anytime_stopped(limits))
+                    {
+                        checkpoint_stop(checkpoint, i, stacks); // The prefix was cut short
+                        break;
+                    }
+                    checkpoint_mark(checkpoint, i);
+                    anytime_mark(limits, i);
+                    checkpoint_tick(checkpoint, incumbent);
+
+                    end_time = trace_clock();
+                    trace_event(TRACE_COMPUTATION, rank, start_time, end_time);
+
+                    // Trade bounds with the other ranks between subtrees without waiting for them
+                    start_time = trace_clock();
+                    shared_bound_exchange(shared_bound, incumbent);
+                    end_time = trace_clock();
+                    trace_event(TRACE_COMMUNICATION, rank, start_time, end_time);
+                }
+                if (size == 1)
+                {
+                    break;
+                }
+
+                // The request carries our bound and finished chunk to rank 0 and the reply brings back the global bound.
+                // A stopped rank reports the part of the chunk it finished and gets no more work.
+                start_time = trace_clock();
+                finished.assign(1, {chunk.start, i - chunk.start});
+                if (anytime_stopped(limits))
+                {
+                    shared_bound_exchange(shared_bound, incumbent);
+                }
+                has_work = request_work(incumbent, chunk, finished);
+                end_time = trace_clock();
+                trace_event(TRACE_COMMUNICATION, rank, start_time, end_time);
+            }
+        }
+        stats_end_search();
+        stats_add_search(search, rank);
 
-        if (paths_since_last_sync >= current_sync_period)
+        // Final gather of results from all processes
+        start_time = trace_clock();
+        shared_bound_free(shared_bound);
+        struct
         {
-            // Perform synchronization
-            start_time = MPI_Wtime();
-            int local_min = local_min_distance;
-            MPI_Allreduce(&local_min, &min_distance, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
-            end_time = MPI_Wtime();
+            int distance;
+            int rank;
+        } local_result, global_result;
 
-            // Log the communication event
-            log_event(logs_filename, "COMMUNICATION", hostname, rank, start_time, end_time);
+        std::vector<int> local_min_path;
+        local_result.distance = incumbent_read(incumbent, local_min_path);
+        local_result.rank = rank;
 
-            // Increase the sync period for next time
-            current_sync_period = std::min(
-                static_cast<int>(current_sync_period * SYNC_INCREASE_FACTOR),
-                MAX_SYNC_PERIOD);
+        MPI_Allreduce(&local_result, &global_result, 1, MPI_2INT, MPI_MINLOC, MPI_COMM_WORLD);
 
-            paths_since_last_sync = 0;
+        int path_size = num_cities;
+        // Broadcast the best path
+        if (rank == global_result.rank)
+        {
+            path_size = local_min_path.size();
+            min_path = local_min_path;
         }
-    }
 
-    // Ensure one final sync at the end
-    if (paths_since_last_sync > 0)
-    {
-        start_time = MPI_Wtime();
-        int local_min = local_min_distance;
-        MPI_Allreduce(&local_min, &min_distance, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
-        end_time = MPI_Wtime();
+        // Broadcast the size of the best path
+        MPI_Bcast(&path_size, 1, MPI_INT, global_result.rank, MPI_COMM_WORLD);
 
-        log_event(logs_filename, "COMMUNICATION", hostname, rank, start_time, end_time);
-    }
+        // Resize min_path on all processes to receive the best path
+        min_path.resize(path_size);
 
-    // Final gather of results from all processes
-    start_time = MPI_Wtime();
-    struct
-    {
-        int distance;
-        int rank;
-    } local_result, global_result;
+        // Broadcast the best path
+        MPI_Bcast(min_path.data(), path_size, MPI_INT, global_result.rank, MPI_COMM_WORLD);
 
-    local_result.distance = local_min_distance;
-    local_result.rank = rank;
+        min_distance = global_result.distance;
 
-    MPI_Allreduce(&local_result, &global_result, 1, MPI_2INT, MPI_MINLOC, MPI_COMM_WORLD);
+        // Unless the search was stopped, it is complete and a job resuming from the
+        // checkpoint only prints the result
+        checkpoint_offer(checkpoint, min_distance, min_path.data(), num_cities);
+        if (!options.checkpoint_filename.empty())
+        {
+            checkpoint_gather_stacks(checkpoint, rank, size);
+        }
+        checkpoint_finish(checkpoint, incumbent, !anytime_stopped(limits));
 
-    int path_size = num_cities;
-    // Broadcast the best path
-    if (rank == global_result.rank)
-    {
-        path_size = local_min_path.size();
-        min_path = local_min_path;
+        end_time = trace_clock();
+        trace_event(TRACE_COMMUNICATION, rank, start_time, end_time);
     }
 
-    // Broadcast the size of the best path
-    MPI_Bcast(&path_size, 1, MPI_INT, global_result.rank, MPI_COMM_WORLD);
-
-    // Resize min_path on all processes to receive the best path
-    min_path.resize(path_size);
-
-    // Broadcast the best path
-    MPI_Bcast(min_path.data(), path_size, MPI_INT, global_result.rank, MPI_COMM_WORLD);
-
-    // Broadcast the best distance
-    MPI_Bcast(&min_distance, 1, MPI_INT, global_result.rank, MPI_COMM_WORLD);
-
-    end_time = MPI_Wtime();
-    log_event(logs_filename, "COMMUNICATION", hostname, rank, start_time, end_time);
-
-    global_end_time = MPI_Wtime();
+    global_end_time = trace_clock();
     double total_time = global_end_time - global_start_time;
 
     // Print the final results (only on rank 0)
@@ -240,9 +383,12 @@ int main(int argc, char *argv[])
             std::cout << min_path[i] + 1 << " "; // +1 because cities are typically 1-indexed in output
         }
         std::cout << std::endl;
+        anytime_print(limits, min_distance, options.solver != SOLVER_HEURISTIC);
         std::cout << "---------------------------------------------" << std::endl;
     }
 
+    trace_finish();
+    stats_finish_ranks(rank, size);
     MPI_Finalize();
     return 0;
 }
@@ -0,0 +1,552 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <mpi.h>
+
+// Dynamic distribution of prefix indices: rank 0 hands out contiguous chunks on
+// request, and the best known distance travels in both directions with every message
+const int TAG_WORK_REQUEST = 1;
+const int TAG_WORK_ASSIGN = 2;
+const int TAG_BATCH_RESULT = 3;   // Result lines of finished instances
+const int TAG_BATCH_REQUEST = 4;  // A rank asks for another instance
+const int TAG_BATCH_INSTANCE = 5; // The file name of the instance, empty once the manifest is exhausted
+const int TAG_BATCH_DONE = 6;     // A rank has sent all its results
+
+// Guided self-scheduling: each chunk is the remaining work split this many times
+// per worker, so chunks start large and shrink to single prefixes near the end
+const int CHUNK_DIVISOR = 2;
+
+struct WorkChunk
+{
+    int start;
+    int count;
+};
+
+// Prefix indices not handed out yet. In the hybrid build the coordinator thread
+// and the other threads of rank 0 draw from the same pool.
+struct WorkPool
+{
+    int next;
+    int total;
+    const PrefixEnumerator *prefixes; // For dropping hopeless prefixes in bound order
+};
+
+// Takes the next guided chunk, sized for `num_workers` consumers
+WorkChunk take_work(WorkPool &pool, int num_workers)
+{
+    WorkChunk chunk;
+#pragma omp critical(work_pool)
+    {
+        int remaining = pool.total - pool.next;
+        chunk.start = pool.next;
+        chunk.count = std::min(remaining, std::max(1, remaining / (CHUNK_DIVISOR * num_workers)));
+        pool.next += chunk.count;
+    }
+    return chunk;
+}
+
+// In the bound order, cuts the pool before the first prefix that cannot beat
+// `best_distance`, so no worker is ever sent it. Dropped prefixes count as finished.
+void drop_hopeless_work(WorkPool &pool, int best_distance, Checkpoint &checkpoint, AnytimeLimits *limits)
+{
+    if (pool.prefixes == nullptr || !pool.prefixes->order)
+        return;
+    long long hopeless = first_hopeless_prefix(*pool.prefixes, best_distance);
+#pragma omp critical(work_pool)
+    {
+        int end = std::max((long long)pool.next, hopeless);
+        if (end < pool.total)
+        {
+            checkpoint_mark_range(checkpoint, end, pool.total - end);
+            if (limits != nullptr)
+                anytime_mark_range(*limits, end, pool.total - end);
+            pool.total = end;
+        }
+    }
+}
+
+// Global best distance kept in an MPI-3 window on rank 0. Ranks fold their local
+// bound into it with an atomic MPI_MIN and get the global one back in the same
+// one-sided operation, so no rank ever waits for another to reach a sync point.
+// The second slot carries the anytime status the same way, with MPI_MAX, so a rank
+// that stops makes every other rank stop at its next exchange.
+struct SharedBound
+{
+    MPI_Win window;
+    int *value;            // {best distance, anytime status} on rank 0
+    AnytimeLimits *limits; // nullptr unless the run may stop early
+};
+
+// Collective: every rank must call it
+void shared_bound_create(SharedBound &shared, int initial_distance, AnytimeLimits &limits, int rank)
+{
+    MPI_Aint window_size = rank == 0 ? 2 * sizeof(int) : 0;
+    MPI_Win_allocate(window_size, sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD, &shared.value, &shared.window);
+    if (rank == 0)
+    {
+        shared.value[0] = initial_distance;
+        shared.value[1] = ANYTIME_RUNNING;
+    }
+    shared.limits = limits.enabled ? &limits : nullptr;
+    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Win_lock_all(0, shared.window);
+}
+
+// Publishes the local bound and lowers the local incumbent to the global one; with
+// anytime limits, also trades the stop status
+void shared_bound_exchange(SharedBound &shared, Incumbent &incumbent)
+{
+    int local = incumbent_distance(incumbent);
+    int global;
+    MPI_Fetch_and_op(&local, &global, MPI_INT, 0, 0, MPI_MIN, shared.window);
+    int local_status = ANYTIME_RUNNING;
+    int global_status = ANYTIME_RUNNING;
+    if (shared.limits != nullptr)
+    {
+        local_status = shared.limits->status.load(std::memory_order_relaxed);
+        MPI_Fetch_and_op(&local_status, &global_status, MPI_INT, 0, 1, MPI_MAX, shared.window);
+    }
+    MPI_Win_flush(0, shared.window);
+    incumbent_lower(incumbent, global);
+    if (global_status != ANYTIME_RUNNING)
+    {
+        anytime_stop(*shared.limits, global_status);
+    }
+}
+
+// Whether the run has been stopped early, as far as this rank knows
+inline bool shared_bound_stopped(const SharedBound &shared)
+{
+    return shared.limits != nullptr && anytime_stopped(*shared.limits);
+}
+
+// Collective: every rank must call it
+void shared_bound_free(SharedBound &shared)
+{
+    MPI_Win_unlock_all(shared.window);
+    MPI_Win_free(&shared.window);
+}
+
+// Rank 0 opens the checkpoint and every rank gets the resumed state, so workers
+// can skip finished prefixes of the chunks they are given. Only rank 0 writes.
+bool checkpoint_broadcast(Checkpoint &checkpoint, PrefixEnumerator &prefixes, const SolverOptions &options,
+                          const std::vector<int> &distances, int num_cities, int rank)
+{
+    int ok = 1;
+    if (rank == 0)
+    {
+        ok = checkpoint_open(checkpoint, options.checkpoint_filename, options.checkpoint_interval, distances, num_cities) &&
+             checkpoint_attach(checkpoint, prefixes, options.prefix_depth);
+    }
+    int state[2] = {ok, checkpoint.resumed};
+    MPI_Bcast(state, 2, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!state[0])
+    {
+        return false;
+    }
+    if (state[1])
+    {
+        long long fields[6] = {prefixes.num_cities, prefixes.start_city, prefixes.depth,
+                               prefixes.count,      prefixes.multiplier, prefixes.offset};
+        MPI_Bcast(fields, 6, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+        prefixes.num_cities = fields[0];
+        prefixes.start_city = fields[1];
+        prefixes.depth = fields[2];
+        prefixes.count = fields[3];
+        prefixes.multiplier = fields[4];
+        prefixes.offset = fields[5];
+        std::vector<uint64_t> words((prefixes.count + 63) / 64);
+        if (rank == 0)
+        {
+            for (size_t w = 0; w < words.size(); w++)
+                words[w] = checkpoint.done[w].load(std::memory_order_relaxed);
+        }
+        else
+        {
+            checkpoint.enabled = true;
+            checkpoint.resumed = true;
+            checkpoint.prefixes = prefixes;
+            checkpoint.best_path.resize(num_cities);
+            checkpoint_resize(checkpoint, prefixes.count);
+        }
+        MPI_Bcast(words.data(), words.size(), MPI_UINT64_T, 0, MPI_COMM_WORLD);
+        MPI_Bcast(&checkpoint.best_distance, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Bcast(checkpoint.best_path.data(), num_cities, MPI_INT, 0, MPI_COMM_WORLD);
+        for (size_t w = 0; w < words.size(); w++)
+            checkpoint.done[w].store(words[w], std::memory_order_relaxed);
+
+        // The stacks the last job stopped in, for whichever rank gets their prefixes
+        std::vector<int64_t> stack_words;
+        if (rank == 0)
+        {
+            for (const auto &entry : checkpoint.saved_stacks)
+                pack_stacks(entry.first, entry.second, stack_words);
+        }
+        int length = stack_words.size();
+        MPI_Bcast(&length, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        stack_words.resize(length);
+        MPI_Bcast(stack_words.data(), length, MPI_INT64_T, 0, MPI_COMM_WORLD);
+        if (rank != 0)
+        {
+            unpack_stacks(stack_words, prefixes, [&](long long index, std::vector<SavedStack> &stacks) {
+                checkpoint.saved_stacks[index].swap(stacks);
+            });
+        }
+    }
+    return true;
+}
+
+// Shares rank 0's instance for the heuristic: the coordinates, or the matrix when
+// the file gave explicit weights. num_cities must already be broadcast.
+void broadcast_instance(TspInstance &instance, int num_cities)
+{
+    int type = instance.type;
+    int explicit_weights = !instance.distances.empty();
+    int header[2] = {type, explicit_weights};
+    MPI_Bcast(header, 2, MPI_INT, 0, MPI_COMM_WORLD);
+    instance.num_cities = num_cities;
+    instance.type = (TsplibWeightType)header[0];
+    if (header[1])
+    {
+        instance.distances.resize((size_t)num_cities * num_cities);
+        MPI_Bcast(instance.distances.data(), num_cities * num_cities, MPI_INT, 0, MPI_COMM_WORLD);
+    }
+    else
+    {
+        instance.x.resize(num_cities);
+        instance.y.resize(num_cities);
+        MPI_Bcast(instance.x.data(), num_cities, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        MPI_Bcast(instance.y.data(), num_cities, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    }
+}
+
+// Every rank gets the shortest of the ranks' tours
+void best_tour_of_ranks(std::pair<std::vector<int>, int> &tour, int num_cities)
+{
+    struct
+    {
+        int distance;
+        int rank;
+    } best;
+    MPI_Comm_rank(MPI_COMM_WORLD, &best.rank);
+    best.distance = tour.second;
+    MPI_Allreduce(MPI_IN_PLACE, &best, 1, MPI_2INT, MPI_MINLOC, MPI_COMM_WORLD);
+    tour.first.resize(num_cities);
+    MPI_Bcast(tour.first.data(), num_cities, MPI_INT, best.rank, MPI_COMM_WORLD);
+    tour.second = best.distance;
+}
+
+// A work request:{bound, tour distance, tour[num_cities], finished chunks as (start, count)...}.
+// The tour and the finished chunks only matter to rank 0's checkpoint.
+const int REQUEST_HEADER = 2;
+
+// Serves work requests until every worker has been told there is nothing left. Once
+// the run is stopped early, every request is answered with an empty chunk.
+void coordinate_work(
+    WorkPool &pool,
+    int num_workers,
+    Incumbent &incumbent,
+    SharedBound &shared_bound,
+    Checkpoint &checkpoint,
+    int rank)
+{
+    const int num_cities = incumbent.path.size();
+    std::vector<int> request;
+    int active_workers = num_workers;
+    while (active_workers > 0)
+    {
+        MPI_Status status;
+        int length;
+        MPI_Probe(MPI_ANY_SOURCE, TAG_WORK_REQUEST, MPI_COMM_WORLD, &status);
+        MPI_Get_count(&status, MPI_INT, &length);
+        request.resize(length);
+        MPI_Recv(request.data(), length, MPI_INT, status.MPI_SOURCE, TAG_WORK_REQUEST, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+        double start_time = trace_clock();
+        incumbent_lower(incumbent, request[0]);
+        shared_bound_exchange(shared_bound, incumbent);
+
+        // Finished chunks are recorded only after the tour that covers them
+        checkpoint_offer(checkpoint, request[1], &request[REQUEST_HEADER], num_cities);
+        for (int k = REQUEST_HEADER + num_cities; k + 1 < length; k += 2)
+        {
+            checkpoint_mark_range(checkpoint, request[k], request[k + 1]);
+            if (shared_bound.limits != nullptr)
+                anytime_mark_range(*shared_bound.limits, request[k], request[k + 1]);
+        }
+        checkpoint_tick(checkpoint, incumbent);
+
+        WorkChunk chunk = {0, 0};
+        if (shared_bound.limits == nullptr || !anytime_poll(*shared_bound.limits))
+        {
+            drop_hopeless_work(pool, incumbent_distance(incumbent), checkpoint, shared_bound.limits);
+            chunk = take_work(pool, num_workers);
+        }
+        int reply[3] = {chunk.start, chunk.count, incumbent_distance(incumbent)};
+        if (chunk.count == 0)
+        {
+            active_workers--;
+        }
+        MPI_Send(reply, 3, MPI_INT, status.MPI_SOURCE, TAG_WORK_ASSIGN, MPI_COMM_WORLD);
+        double end_time = trace_clock();
+        trace_event(TRACE_ORCHESTRATION, rank, start_time, end_time);
+    }
+}
+
+// Reports the local bound, the local best tour and the chunks finished since the
+// last request to the coordinator, and waits for the next chunk. Returns false
+// once the work is exhausted.
+bool request_work(Incumbent &incumbent, WorkChunk &chunk, std::vector<WorkChunk> &finished)
+{
+    std::vector<int> tour;
+    int tour_distance = incumbent_read(incumbent, tour);
+    std::vector<int> request;
+    request.reserve(REQUEST_HEADER + tour.size() + 2 * finished.size());
+    request.push_back(incumbent_distance(incumbent));
+    request.push_back(tour_distance);
+    request.insert(request.end(), tour.begin(), tour.end());
+    for (const WorkChunk &done : finished)
+    {
+        request.push_back(done.start);
+        request.push_back(done.count);
+    }
+    finished.clear();
+    MPI_Send(request.data(), request.size(), MPI_INT, 0, TAG_WORK_REQUEST, MPI_COMM_WORLD);
+
+    int reply[3];
+    MPI_Recv(reply, 3, MPI_INT, 0, TAG_WORK_ASSIGN, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    chunk.start = reply[0];
+    chunk.count = reply[1];
+    incumbent_lower(incumbent, reply[2]);
+    return chunk.count > 0;
+}
+
+// Batch mode on rank 0: deals instance file names to the ranks that ask for one and
+// prints the result lines they send back, until every rank is done
+int batch_coordinate(const SolverOptions &options, int num_workers)
+{
+    std::ifstream file;
+    std::istream *manifest;
+    std::istringstream empty;
+    int status = 0;
+    if (!open_manifest(options.input_filename, file, manifest))
+    {
+        manifest = &empty; // Still answer the workers, with no instances
+        status = 1;
+    }
+
+    int working = num_workers;
+    bool more = true;
+    std::string filename;
+    std::vector<char> buffer;
+    while (working > 0)
+    {
+        MPI_Status message;
+        int length;
+        MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &message);
+        MPI_Get_count(&message, MPI_CHAR, &length);
+        buffer.resize(length);
+        MPI_Recv(buffer.data(), length, MPI_CHAR, message.MPI_SOURCE, message.MPI_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+        if (message.MPI_TAG == TAG_BATCH_RESULT)
+        {
+            fwrite(buffer.data(), 1, length, stdout);
+            fflush(stdout);
+        }
+        else if (message.MPI_TAG == TAG_BATCH_REQUEST)
+        {
+            more = more && batch_next(*manifest, filename);
+            if (!more)
+            {
+                filename.clear();
+            }
+            MPI_Send(filename.data(), filename.size(), MPI_CHAR, message.MPI_SOURCE, TAG_BATCH_INSTANCE, MPI_COMM_WORLD);
+        }
+        else if (message.MPI_TAG == TAG_BATCH_DONE)
+        {
+            working--;
+        }
+    }
+    return status;
+}
+
+// Sends the result lines collected so far, one per line, and asks rank 0 for the
+// next instance. Returns false once the manifest is exhausted.
+bool batch_request(std::string &results, std::string &filename)
+{
+    if (!results.empty())
+    {
+        MPI_Send(results.data(), results.size(), MPI_CHAR, 0, TAG_BATCH_RESULT, MPI_COMM_WORLD);
+        results.clear();
+    }
+    MPI_Send(nullptr, 0, MPI_CHAR, 0, TAG_BATCH_REQUEST, MPI_COMM_WORLD);
+
+    MPI_Status message;
+    int length;
+    MPI_Probe(0, TAG_BATCH_INSTANCE, MPI_COMM_WORLD, &message);
+    MPI_Get_count(&message, MPI_CHAR, &length);
+    filename.resize(length);
+    MPI_Recv(&filename[0], length, MPI_CHAR, 0, TAG_BATCH_INSTANCE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    return length > 0;
+}
+
+// Sends the last result lines and tells rank 0 this rank is done
+void batch_finish(std::string &results)
+{
+    if (!results.empty())
+    {
+        MPI_Send(results.data(), results.size(), MPI_CHAR, 0, TAG_BATCH_RESULT, MPI_COMM_WORLD);
+        results.clear();
+    }
+    MPI_Send(nullptr, 0, MPI_CHAR, 0, TAG_BATCH_DONE, MPI_COMM_WORLD);
+}
+
+// Gathers plain records of every rank on rank 0
+template <typename Record>
+void gather_records(std::vector<Record> &records, int rank, int size)
+{
+    int bytes = records.size() * sizeof(Record);
+    std::vector<int> counts(size), displacements(size);
+    MPI_Gather(&bytes, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    int total = 0;
+    for (int r = 0; r < size; r++)
+    {
+        displacements[r] = total;
+        total += counts[r];
+    }
+    std::vector<Record> gathered(rank == 0 ? total / sizeof(Record) : 0);
+    MPI_Gatherv(records.data(), bytes, MPI_BYTE, gathered.data(), counts.data(), displacements.data(), MPI_BYTE, 0,
+                MPI_COMM_WORLD);
+    if (rank == 0)
+    {
+        records.swap(gathered);
+    }
+}
+
+// Collective: hands the stacks every rank stopped in to rank 0, which writes them
+void checkpoint_gather_stacks(Checkpoint &checkpoint, int rank, int size)
+{
+    std::vector<int64_t> words;
+    for (const auto &entry : checkpoint.stopped_stacks)
+        pack_stacks(entry.first, entry.second, words);
+    gather_records(words, rank, size);
+    if (rank == 0)
+    {
+        unpack_stacks(words, checkpoint.prefixes, [&](long long index, std::vector<SavedStack> &stacks) {
+            checkpoint_stop(checkpoint, index, stacks);
+        });
+    }
+}
+
+// Collective: merges the statistics of every rank and prints them on rank 0
+void stats_finish_ranks(int rank, int size)
+{
+    if (!stats_state.enabled)
+    {
+        return;
+    }
+    StatsReport report;
+    stats_report(report);
+    gather_records(report.workers, rank, size);
+    gather_records(report.improvements, rank, size);
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : report.depth_nodes, report.depth_nodes, STATS_MAX_DEPTH, MPI_LONG_LONG,
+               MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : report.depth_pruned, report.depth_pruned, STATS_MAX_DEPTH, MPI_LONG_LONG,
+               MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : report.memo_counts, report.memo_counts, MEMO_COUNTERS, MPI_LONG_LONG, MPI_SUM,
+               0, MPI_COMM_WORLD);
+    if (rank == 0)
+    {
+        std::sort(report.improvements.begin(), report.improvements.end(),
+                  [](const ImprovementRecord &a, const ImprovementRecord &b) { return a.time < b.time; });
+        stats_print(report);
+    }
+}
+
+// Minimum time between one-sided bound exchanges of a hybrid rank, in seconds
+const double BOUND_EXCHANGE_INTERVAL = 0.01;
+
+// A chunk whose prefixes are still being searched by the threads of a node
+struct RunningChunk
+{
+    WorkChunk chunk;
+    int left;
+};
+
+// Chunk from the coordinator that all threads of a hybrid rank drain together
+struct NodeQueue
+{
+    int next;
+    int end;
+    bool exhausted;
+    double last_exchange;
+    std::vector<RunningChunk> running;
+    std::vector<WorkChunk> finished; // Reported with the next request
+};
+
+// Records that one of the node's threads finished prefix `index`
+void node_prefix_done(NodeQueue &queue, int index)
+{
+    for (size_t c = 0; c < queue.running.size(); c++)
+    {
+        const WorkChunk &chunk = queue.running[c].chunk;
+        if (index >= chunk.start && index < chunk.start + chunk.count)
+        {
+            if (--queue.running[c].left == 0)
+            {
+                queue.finished.push_back(chunk);
+                queue.running.erase(queue.running.begin() + c);
+            }
+            return;
+        }
+    }
+}
+
+// Returns the next prefix index for one of this rank's threads, or -1 once the
+// coordinator has no work left. `done_index` is the prefix the thread just finished,
+// or -1. Whichever thread finds the chunk empty refills it, so MPI is called by one
+// thread at a time (MPI_THREAD_SERIALIZED). A stopped run drops the rest of the
+// chunk; its last request tells the coordinator and reports what was finished.
+int next_node_prefix(NodeQueue &queue, Incumbent &incumbent, SharedBound &shared_bound, int done_index)
+{
+    int index = -1;
+#pragma omp critical(node_queue)
+    {
+        if (done_index >= 0)
+        {
+            node_prefix_done(queue, done_index);
+        }
+        if (shared_bound_stopped(shared_bound) && !queue.exhausted)
+        {
+            queue.next = queue.end;
+            shared_bound_exchange(shared_bound, incumbent);
+        }
+        if (queue.next == queue.end && !queue.exhausted)
+        {
+            WorkChunk chunk;
+            if (request_work(incumbent, chunk, queue.finished))
+            {
+                queue.next = chunk.start;
+                queue.end = chunk.start + chunk.count;
+                queue.running.push_back({chunk, chunk.count});
+            }
+            else
+            {
+                queue.exhausted = true;
+            }
+        }
+        if (trace_clock() - queue.last_exchange > BOUND_EXCHANGE_INTERVAL)
+        {
+            shared_bound_exchange(shared_bound, incumbent);
+            queue.last_exchange = trace_clock();
+        }
+        if (queue.next < queue.end)
+        {
+            index = queue.next++;
+        }
+    }
+    return index;
+}
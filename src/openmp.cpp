@@ -5,11 +5,14 @@
 #include <unistd.h>
 #include <omp.h>
 #include "utils.h"
+#include "task_search.cpp"
+#include "batch_tasks.cpp"
 
 int min_distance = INT_MAX;
 std::vector<int> min_path;
 
 std::vector<int> distances;
+std::vector<int> neighbors;
 int num_cities;
 
 int main(int argc, char *argv[])
@@ -18,22 +21,16 @@ int main(int argc, char *argv[])
     global_start_time = omp_get_wtime();
     double start_time = omp_get_wtime();
 
-    std::string input_filename;
-    std::string logs_filename;
-    if (argc == 3)
+    SolverOptions options;
+    if (!parse_options(argc, argv, options))
     {
-        input_filename = argv[1];
-        logs_filename = argv[2];
-    }
-    else
-    {
-        std::cout << "Usage: " << argv[0] << " <input_data_filename> <logs_filename>" << std::endl;
+        print_usage(argv[0]);
         return 0;
     }
-
-    // Clear logs file
-    std::ofstream logs_file(logs_filename, std::ios::out);
-    logs_file.close();
+    AnytimeLimits limits;
+    anytime_init(limits, options.time_limit, options.gap);
+    std::string input_filename = options.input_filename;
+    std::string logs_filename = options.logs_filename;
 
     // Get hostname
     std::string hostname;
@@ -49,108 +46,227 @@ int main(int argc, char *argv[])
         hostname = "Unknown";
     }
 
-    // Setup: read input file
-    num_cities = read_tsplib_matrix(input_filename, distances);
+    // Buffer phase events per thread and write them out in bulk
+    trace_init(logs_filename, hostname, options.trace_format, options.trace_sample, true);
+    stats_init(options.stats, 0);
+
+    // Batch mode: the team solves the instances of the manifest as tasks
+    if (options.batch)
+    {
+        std::ifstream file;
+        std::istream *manifest;
+        if (!open_manifest(input_filename, file, manifest))
+        {
+            return 1;
+        }
+        batch_run_tasks(
+            options, [&](std::string &filename) { return batch_next(*manifest, filename); }, batch_print);
+        trace_finish();
+        return 0;
+    }
+
+    // Setup: read input file. The heuristic keeps coordinates as they are and
+    // computes distances on demand instead of storing the matrix.
+    TspInstance instance;
+    if (options.solver == SOLVER_HEURISTIC)
+    {
+        num_cities = read_tsplib_instance(input_filename, instance, true);
+        if (num_cities > 0 && !heuristic_supported(instance))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        num_cities = read_tsplib_matrix(input_filename, distances, solver_cities_supported(options.solver));
+    }
+    if (num_cities == 0)
+    {
+        return 1;
+    }
 
     // Set starting city
     int first_city = 0;
 
-    // Create all possible pre-paths to be explored and shuffle them
-    std::vector<std::vector<int>> paths;
-    create_paths(paths, first_city, num_cities);
-
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::shuffle(paths.begin(), paths.end(), gen);
+    // Enumerate the pre-paths to be explored lazily, in a random or bound order
+    PrefixEnumerator prefixes;
+    if (options.solver == SOLVER_BRANCH_AND_BOUND)
+    {
+        std::random_device rd;
+        if (!init_prefixes(prefixes, num_cities, first_city, options.prefix_depth, omp_get_max_threads(), rd(),
+                           options.prefix_order == ORDER_BOUND))
+        {
+            return 1;
+        }
+    }
 
-    int total_paths = paths.size(); // Define total_paths here
+    // Resume from the checkpoint of an earlier job, if there is one, then rank the
+    // prefixes if they go in bound order
+    Checkpoint checkpoint;
+    if (options.solver == SOLVER_BRANCH_AND_BOUND &&
+        (!checkpoint_open(checkpoint, options.checkpoint_filename, options.checkpoint_interval, distances, num_cities) ||
+         !checkpoint_attach(checkpoint, prefixes, options.prefix_depth) ||
+         !order_prefixes_by_bound(prefixes, distances)))
+    {
+        return 1;
+    }
 
     double end_time = omp_get_wtime();
-    log_event(logs_filename, "SETUP", hostname, 0, start_time, end_time);
+    trace_event(TRACE_SETUP, 0, start_time, end_time);
 
-// Explore all possible pre-paths in parallel
-#pragma omp parallel
+    if (options.solver == SOLVER_HELD_KARP)
     {
-        // Compute initial minimum distance and path
-        int thread_id = omp_get_thread_num();
+        // Solve exactly with the bitmask dynamic program, each layer split across the team
         double start_time = omp_get_wtime();
-        std::pair<std::vector<int>, int> result = nearest_neighbor_tsp(distances, num_cities);
-        std::vector<int> initial_path = result.first;
-        int initial_distance = result.second;
-        int thread_min_distance = initial_distance;
-        std::vector<int> thread_min_path = initial_path;
+        std::pair<std::vector<int>, int> result = held_karp_tsp(distances, num_cities);
+        min_path = result.first;
+        min_distance = result.second;
         double end_time = omp_get_wtime();
-        log_event(logs_filename, "COMPUTATION", hostname, thread_id, start_time, end_time);
-
-        int paths_processed = 0;
-        int current_sync_period = INITIAL_SYNC_PERIOD;
-        int paths_since_last_sync = 0;
+        trace_event(TRACE_COMPUTATION, 0, start_time, end_time);
+    }
+    else if (options.solver == SOLVER_HEURISTIC)
+    {
+        // Every thread runs its own chained Lin-Kernighan from a different start
+        double start_time = omp_get_wtime();
+        std::random_device rd;
+        std::pair<std::vector<int>, int> result =
+            heuristic_tour(instance, first_city, 0, 1, omp_get_max_threads(), rd(), limits);
+        min_path = result.first;
+        min_distance = result.second;
+        double end_time = omp_get_wtime();
+        trace_event(TRACE_COMPUTATION, 0, start_time, end_time);
+    }
+    else
+    {
+        // Compute initial minimum distance and path: best locally improved multi-start tour, shared by every thread as the incumbent
+        double start_time = omp_get_wtime();
+        build_neighbor_lists(distances, num_cities, neighbors);
+        std::pair<std::vector<int>, int> result = initial_tour(distances, neighbors, num_cities, first_city, 0, 1);
+        checkpoint_seed_tour(checkpoint, result);
+        Incumbent incumbent;
+        init_incumbent(incumbent, result, num_cities);
+        DominanceMemo memo;
+        init_memo(memo, options.memo_megabytes);
 
-#pragma omp for schedule(dynamic)
-        for (int i = 0; i < total_paths; i++)
+        // Precompute the lower bound tables once; each thread works on its own copy
+        LowerBound shared_bound;
+        init_lower_bound(shared_bound, options.bound, distances, num_cities, first_city);
+        anytime_attach(limits, prefixes, shared_bound, distances, incumbent, checkpoint);
+        anytime_publish(limits, result.second, result.first.data(), num_cities);
+        SearchPrefixFn search_prefix = search_prefix_for(num_cities);
+        if (search_prefix == nullptr)
         {
-            double computation_start = omp_get_wtime();
-
-            std::vector<int> path = paths[i];
-            std::vector<int> visited(num_cities, false);
-            int curr_distance = 0;
+            return 1;
+        }
+        double end_time = omp_get_wtime();
+        trace_event(TRACE_COMPUTATION, 0, start_time, end_time);
 
-            // Initialize the curr-distance and visited vector for the current pre-path
-            for (int j = 0; j < (int)path.size(); j++)
+        if (options.schedule == SCHEDULE_TASKS)
+        {
+            SearchPrefixTasksFn search_prefix_tasks = search_prefix_tasks_for(num_cities);
+            std::vector<SearchContext> contexts(omp_get_max_threads());
+            for (SearchContext &search : contexts)
             {
-                if (j < (int)path.size() - 1)
-                {
-                    curr_distance += get_distance(path[j], path[j + 1], distances, num_cities);
-                }
-                visited[path[j]] = true;
+                init_search(search, distances, neighbors, num_cities, shared_bound, incumbent);
+                attach_memo(search, memo);
+                attach_limits(search, limits);
             }
+            TaskControl control;
+            init_task_control(control, num_cities, prefixes.depth, omp_get_max_threads());
 
-            // Explore the current pre-path
-            dfs(path, visited, curr_distance, thread_min_distance, thread_min_path, distances, num_cities);
-
-            double computation_end = omp_get_wtime();
-            log_event(logs_filename, "COMPUTATION", hostname, thread_id, computation_start, computation_end);
-
-            paths_processed++;
-
-            paths_since_last_sync++;
-
-            // Periodic synchronization based on calculated update frequency
-            if (paths_since_last_sync >= current_sync_period)
+            stats_begin_search();
+// One task per pre-path; tasks split their subtrees further while threads would idle
+#pragma omp parallel
+#pragma omp single
+            for (long long i = 0; i < prefixes.count && !anytime_stopped(limits); i++)
             {
-                double communication_start = omp_get_wtime();
-#pragma omp critical
+                if (checkpoint_done(checkpoint, i) || drop_hopeless_prefix(prefixes, i, incumbent, checkpoint, limits))
+                    continue;
+                control.pending.fetch_add(1, std::memory_order_relaxed);
+#pragma omp task firstprivate(i) shared(control, contexts, prefixes, checkpoint, incumbent, limits)
                 {
-                    if (thread_min_distance < min_distance)
+                    double computation_start = omp_get_wtime();
+                    int prefix[KERNEL_MAX_CITIES];
+                    std::vector<SavedStack> stacks;
+                    // The incumbent may have improved since the task was created
+                    if (!drop_hopeless_prefix(prefixes, i, incumbent, checkpoint, limits))
                     {
-                        min_distance = thread_min_distance;
-                        min_path = thread_min_path;
+                        int prefix_length = prefix_at(prefixes, i, prefix);
+                        checkpoint_stacks(checkpoint, i, stacks);
+                        search_prefix_tasks(contexts.data(), prefix, prefix_length, control, &stacks);
                     }
-                }
-                double communication_end = omp_get_wtime();
-                log_event(logs_filename, "COMMUNICATION", hostname, thread_id, communication_start, communication_end);
+                    control.pending.fetch_sub(1, std::memory_order_relaxed);
 
-                // Increase the sync period for next time
-                current_sync_period = std::min(
-                    static_cast<int>(current_sync_period * SYNC_INCREASE_FACTOR),
-                    MAX_SYNC_PERIOD);
+                    // The subtree tasks were waited for, so the whole prefix is finished
+                    // unless the search was stopped
+                    if (anytime_stopped(limits))
+                    {
+                        checkpoint_stop(checkpoint, i, stacks);
+                    }
+                    else
+                    {
+                        checkpoint_mark(checkpoint, i);
+                        anytime_mark(limits, i);
+                        checkpoint_tick(checkpoint, incumbent);
+                    }
 
-                paths_since_last_sync = 0;
+                    double computation_end = omp_get_wtime();
+                    trace_event(TRACE_COMPUTATION, omp_get_thread_num(), computation_start, computation_end);
+                }
+            }
+            stats_end_search();
+            for (int t = 0; t < (int)contexts.size(); t++)
+            {
+                stats_add_search(contexts[t], t);
             }
         }
-
-        // Final update of global minimum
-        double communication_start = omp_get_wtime();
-#pragma omp critical
+        else
         {
-            if (thread_min_distance < min_distance)
+            stats_begin_search();
+// Explore all possible pre-paths in parallel
+#pragma omp parallel
             {
-                min_distance = thread_min_distance;
-                min_path = thread_min_path;
+                int thread_id = omp_get_thread_num();
+                SearchContext search;
+                init_search(search, distances, neighbors, num_cities, shared_bound, incumbent);
+                attach_memo(search, memo);
+                attach_limits(search, limits);
+                int prefix[KERNEL_MAX_CITIES];
+                std::vector<SavedStack> stacks;
+
+#pragma omp for schedule(dynamic)
+                for (long long i = 0; i < prefixes.count; i++)
+                {
+                    if (checkpoint_done(checkpoint, i) || anytime_stopped(limits) ||
+                        drop_hopeless_prefix(prefixes, i, incumbent, checkpoint, limits))
+                        continue;
+                    double computation_start = omp_get_wtime();
+
+                    // Explore the current pre-path; improved tours are published to the incumbent directly
+                    int prefix_length = prefix_at(prefixes, i, prefix);
+                    checkpoint_stacks(checkpoint, i, stacks);
+                    search_prefix(search, prefix, prefix_length, &stacks);
+                    if (anytime_stopped(limits))
+                    {
+                        checkpoint_stop(checkpoint, i, stacks);
+                    }
+                    else
+                    {
+                        checkpoint_mark(checkpoint, i);
+                        anytime_mark(limits, i);
+                        checkpoint_tick(checkpoint, incumbent);
+                    }
+
+                    double computation_end = omp_get_wtime();
+                    trace_event(TRACE_COMPUTATION, thread_id, computation_start, computation_end);
+                }
+                stats_add_search(search, thread_id);
             }
+            stats_end_search();
         }
-        double communication_end = omp_get_wtime();
-        log_event(logs_filename, "COMMUNICATION", hostname, thread_id, communication_start, communication_end);
+
+        checkpoint_finish(checkpoint, incumbent, !anytime_stopped(limits));
+        min_distance = incumbent_read(incumbent, min_path);
     }
 
     global_end_time = omp_get_wtime();
@@ -166,7 +282,10 @@ int main(int argc, char *argv[])
         std::cout << min_path[i] + 1 << ", ";
     }
     std::cout << std::endl;
+    anytime_print(limits, min_distance, options.solver != SOLVER_HEURISTIC);
     std::cout << "---------------------------------------------" << std::endl;
 
+    trace_finish();
+    stats_finish();
     return 0;
 }
@@ -0,0 +1,290 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+enum SolverMode
+{
+    SOLVER_BRANCH_AND_BOUND, // Prefix enumeration + depth-first branch and bound
+    SOLVER_HELD_KARP,        // Bitmask dynamic programming over (visited, last) states
+    SOLVER_HEURISTIC         // Multi-start chained Lin-Kernighan for large instances; not exact
+};
+
+enum ScheduleMode
+{
+    SCHEDULE_LOOP, // Prefixes dealt out by a dynamic loop, each subtree searched by one thread
+    SCHEDULE_TASKS // Prefixes as tasks that split large subtrees further (OpenMP build only)
+};
+
+enum PrefixOrderMode
+{
+    ORDER_RANDOM, // Prefixes in a seeded scrambled order
+    ORDER_BOUND   // Cheapest lower bound first; prefixes that cannot beat the incumbent are dropped
+};
+
+struct SolverOptions
+{
+    std::string input_filename;
+    std::string logs_filename;
+    SolverMode solver = SOLVER_BRANCH_AND_BOUND;
+    BoundKind bound = BOUND_AUTO;
+    int prefix_depth = 0; // Cities per work unit; 0 picks one from the city and worker counts
+    ScheduleMode schedule = SCHEDULE_LOOP;
+    PrefixOrderMode prefix_order = ORDER_RANDOM;
+    TraceFormat trace_format = TRACE_CSV;
+    int trace_sample = 1; // Keep one in this many events per thread
+    std::string checkpoint_filename; // Empty disables checkpoints
+    double checkpoint_interval = CHECKPOINT_DEFAULT_INTERVAL;
+    bool stats = false; // Print search statistics and hardware counters at exit
+    bool batch = false; // input_filename lists the instances to solve, one per line
+    int memo_megabytes = MEMO_DEFAULT_MEGABYTES; // Dominance memo per process (per instance in flight with --batch); 0 disables it
+    double time_limit = 0; // Seconds before bnb stops with the best tour so far; 0 for none
+    double gap = -1;       // Percent above the lower bound at which bnb may stop; < 0 for none
+};
+
+// The size check the loader runs for a solver. The heuristic keeps coordinates instead
+// of a matrix, so it takes any size and checks the instance once it is loaded.
+CitiesSupportedFn solver_cities_supported(SolverMode solver)
+{
+    if (solver == SOLVER_HELD_KARP)
+        return held_karp_supported;
+    if (solver == SOLVER_BRANCH_AND_BOUND)
+        return branch_and_bound_supported;
+    return nullptr;
+}
+
+void print_usage(const char *program)
+{
+    std::cout << "Usage: " << program << " <input_data_filename> <logs_filename> [options]" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --solver=bnb|held-karp|heuristic  solver to run; heuristic is not exact but scales to" << std::endl;
+    std::cout << "                                    thousands of cities (default: bnb)" << std::endl;
+    std::cout << "  --bound=auto|none|min-edge|one-tree" << std::endl;
+    std::cout << "                                    lower bound used to prune bnb; one-tree needs symmetric" << std::endl;
+    std::cout << "                                    distances, auto uses it for those and min-edge otherwise" << std::endl;
+    std::cout << "                                    (default: auto)" << std::endl;
+    std::cout << "  --depth=N                         cities per bnb work unit (default: automatic)" << std::endl;
+    std::cout << "  --schedule=loop|tasks             how OpenMP threads share bnb work (default: loop)" << std::endl;
+    std::cout << "  --order=random|bound              order bnb work units are handed out in (default: random)" << std::endl;
+    std::cout << "  --trace=csv|binary                logs file format (default: csv)" << std::endl;
+    std::cout << "  --trace-sample=N                  keep one in every N phase events (default: 1)" << std::endl;
+    std::cout << "  --checkpoint=FILE                 save bnb progress to FILE and resume from it if present" << std::endl;
+    std::cout << "  --checkpoint-interval=SECONDS     time between checkpoints (default: 60)" << std::endl;
+    std::cout << "  --memo=MB                         dominance memo size per process for bnb, 0 disables (default: 16)" << std::endl;
+    std::cout << "  --time-limit=SECONDS              stop bnb after SECONDS with the best tour and a lower bound;" << std::endl;
+    std::cout << "                                    the heuristic keeps improving its tour until then" << std::endl;
+    std::cout << "  --gap=PERCENT                     stop bnb once the best tour is within PERCENT of the bound" << std::endl;
+    std::cout << "  --stats                           print search statistics and hardware counters at exit" << std::endl;
+    std::cout << "  --batch                           input is a list of instance files (\"-\" reads stdin);" << std::endl;
+    std::cout << "                                    print one result line per instance" << std::endl;
+}
+
+// Returns the value of a "--name=value" argument, or nullptr if arg is not that option
+const char *option_value(const char *arg, const char *name)
+{
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) == 0 && arg[length] == '=')
+    {
+        return arg + length + 1;
+    }
+    return nullptr;
+}
+
+bool parse_options(int argc, char *argv[], SolverOptions &options)
+{
+    if (argc < 3)
+    {
+        return false;
+    }
+    options.input_filename = argv[1];
+    options.logs_filename = argv[2];
+
+    for (int i = 3; i < argc; i++)
+    {
+        const char *value;
+        if ((value = option_value(argv[i], "--solver")) != nullptr)
+        {
+            if (strcmp(value, "bnb") == 0)
+            {
+                options.solver = SOLVER_BRANCH_AND_BOUND;
+            }
+            else if (strcmp(value, "held-karp") == 0)
+            {
+                options.solver = SOLVER_HELD_KARP;
+            }
+            else if (strcmp(value, "heuristic") == 0)
+            {
+                options.solver = SOLVER_HEURISTIC;
+            }
+            else
+            {
+                std::cerr << "Error: Unknown solver '" << value << "'." << std::endl;
+                return false;
+            }
+        }
+        else if ((value = option_value(argv[i], "--bound")) != nullptr)
+        {
+            if (strcmp(value, "auto") == 0)
+            {
+                options.bound = BOUND_AUTO;
+            }
+            else if (strcmp(value, "none") == 0)
+            {
+                options.bound = BOUND_NONE;
+            }
+            else if (strcmp(value, "min-edge") == 0)
+            {
+                options.bound = BOUND_MIN_EDGE;
+            }
+            else if (strcmp(value, "one-tree") == 0)
+            {
+                options.bound = BOUND_ONE_TREE;
+            }
+            else
+            {
+                std::cerr << "Error: Unknown bound '" << value << "'." << std::endl;
+                return false;
+            }
+        }
+        else if ((value = option_value(argv[i], "--depth")) != nullptr)
+        {
+            options.prefix_depth = atoi(value);
+            if (options.prefix_depth < 1)
+            {
+                std::cerr << "Error: --depth must be at least 1." << std::endl;
+                return false;
+            }
+        }
+        else if ((value = option_value(argv[i], "--memo")) != nullptr)
+        {
+            options.memo_megabytes = atoi(value);
+            if (options.memo_megabytes < 0)
+            {
+                std::cerr << "Error: --memo must not be negative." << std::endl;
+                return false;
+            }
+        }
+        else if ((value = option_value(argv[i], "--schedule")) != nullptr)
+        {
+            if (strcmp(value, "loop") == 0)
+            {
+                options.schedule = SCHEDULE_LOOP;
+            }
+            else if (strcmp(value, "tasks") == 0)
+            {
+                options.schedule = SCHEDULE_TASKS;
+            }
+            else
+            {
+                std::cerr << "Error: Unknown schedule '" << value << "'." << std::endl;
+                return false;
+            }
+        }
+        else if ((value = option_value(argv[i], "--order")) != nullptr)
+        {
+            if (strcmp(value, "random") == 0)
+            {
+                options.prefix_order = ORDER_RANDOM;
+            }
+            else if (strcmp(value, "bound") == 0)
+            {
+                options.prefix_order = ORDER_BOUND;
+            }
+            else
+            {
+                std::cerr << "Error: Unknown order '" << value << "'." << std::endl;
+                return false;
+            }
+        }
+        else if ((value = option_value(argv[i], "--trace")) != nullptr)
+        {
+            if (strcmp(value, "csv") == 0)
+            {
+                options.trace_format = TRACE_CSV;
+            }
+            else if (strcmp(value, "binary") == 0)
+            {
+                options.trace_format = TRACE_BINARY;
+            }
+            else
+            {
+                std::cerr << "Error: Unknown trace format '" << value << "'." << std::endl;
+                return false;
+            }
+        }
+        else if ((value = option_value(argv[i], "--trace-sample")) != nullptr)
+        {
+            options.trace_sample = atoi(value);
+            if (options.trace_sample < 1)
+            {
+                std::cerr << "Error: --trace-sample must be at least 1." << std::endl;
+                return false;
+            }
+        }
+        else if ((value = option_value(argv[i], "--checkpoint")) != nullptr)
+        {
+            options.checkpoint_filename = value;
+            if (options.checkpoint_filename.empty())
+            {
+                std::cerr << "Error: --checkpoint needs a file name." << std::endl;
+                return false;
+            }
+        }
+        else if ((value = option_value(argv[i], "--checkpoint-interval")) != nullptr)
+        {
+            options.checkpoint_interval = atof(value);
+            if (options.checkpoint_interval <= 0)
+            {
+                std::cerr << "Error: --checkpoint-interval must be positive." << std::endl;
+                return false;
+            }
+        }
+        else if ((value = option_value(argv[i], "--time-limit")) != nullptr)
+        {
+            options.time_limit = atof(value);
+            if (options.time_limit <= 0)
+            {
+                std::cerr << "Error: --time-limit must be positive." << std::endl;
+                return false;
+            }
+        }
+        else if ((value = option_value(argv[i], "--gap")) != nullptr)
+        {
+            options.gap = atof(value);
+            if (options.gap < 0)
+            {
+                std::cerr << "Error: --gap must not be negative." << std::endl;
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            options.stats = true;
+        }
+        else if (strcmp(argv[i], "--batch") == 0)
+        {
+            options.batch = true;
+        }
+        else
+        {
+            std::cerr << "Error: Unknown option '" << argv[i] << "'." << std::endl;
+            return false;
+        }
+    }
+    if (options.batch && !options.checkpoint_filename.empty())
+    {
+        std::cerr << "Error: --checkpoint cannot be combined with --batch." << std::endl;
+        return false;
+    }
+    if (options.batch && (options.time_limit > 0 || options.gap >= 0))
+    {
+        std::cerr << "Error: --time-limit and --gap cannot be combined with --batch." << std::endl;
+        return false;
+    }
+    if (options.batch && options.stats)
+    {
+        std::cerr << "Error: --stats cannot be combined with --batch." << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Prefixes are tours' first `depth` cities, starting at the start city. Instead of
+// materializing them like create_paths(), each prefix is decoded on demand from its
+// index (unranking of partial permutations), so memory does not grow with the count.
+
+// Enough work units per worker for dynamic scheduling to even out subtree costs
+const int PREFIXES_PER_WORKER = 64;
+// Most prefixes the bound order will rank; it keeps a rank and a bound for each
+const long long PREFIX_ORDER_MAX = 1LL << 24;
+
+// Bound order (--order=bound): indices sorted by a lower bound on the tours through
+// each prefix, so work is handed out most promising first and, once the incumbent
+// reaches the bound at some index, everything from there on can be dropped unseen
+struct PrefixOrder
+{
+    std::vector<int> ranks;  // Lexicographic rank of the prefix at each index
+    std::vector<int> bounds; // Its bound; ascending
+};
+
+struct PrefixEnumerator
+{
+    int num_cities;
+    int start_city;
+    int depth;            // Cities per prefix, including the start city
+    long long count;      // Number of prefixes
+    long long multiplier; // Scrambled order: index -> (index * multiplier + offset) % count
+    long long offset;     // A multiplier of 0 selects the bound order instead
+    std::shared_ptr<const PrefixOrder> order; // Set by order_prefixes_by_bound()
+};
+
+// Number of prefixes of the given depth, or -1 if it exceeds INT_MAX (indices travel as ints)
+long long prefix_count(int num_cities, int depth)
+{
+    long long count = 1;
+    for (int k = 1; k < depth; k++)
+    {
+        count *= num_cities - k;
+        if (count > INT_MAX)
+            return -1;
+    }
+    return count;
+}
+
+// Shallowest depth that yields PREFIXES_PER_WORKER prefixes per worker
+int choose_prefix_depth(int num_cities, int num_workers)
+{
+    long long target = (long long)PREFIXES_PER_WORKER * (num_workers > 0 ? num_workers : 1);
+    int depth = 2;
+    while (depth < num_cities)
+    {
+        long long count = prefix_count(num_cities, depth);
+        if (count < 0 || count >= target)
+            break;
+        depth++;
+    }
+    if (prefix_count(num_cities, depth) < 0)
+        depth--;
+    return std::min(depth, num_cities); // A single city is its own prefix
+}
+
+long long gcd(long long a, long long b)
+{
+    while (b != 0)
+    {
+        long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// depth <= 0 picks one with choose_prefix_depth(). The seed fixes the visiting order,
+// unless `bound_order` asks for order_prefixes_by_bound() to rank the prefixes later.
+bool init_prefixes(PrefixEnumerator &prefixes, int num_cities, int start_city, int depth, int num_workers, unsigned int seed,
+                   bool bound_order = false)
+{
+    if (depth <= 0)
+        depth = choose_prefix_depth(num_cities, num_workers);
+    if (depth < 1 || depth > num_cities)
+    {
+        std::cerr << "Error: Prefix depth must be between 1 and " << num_cities << "." << std::endl;
+        return false;
+    }
+    prefixes.num_cities = num_cities;
+    prefixes.start_city = start_city;
+    prefixes.depth = depth;
+    prefixes.count = prefix_count(num_cities, depth);
+    if (prefixes.count < 0)
+    {
+        std::cerr << "Error: Prefix depth " << depth << " yields too many prefixes." << std::endl;
+        return false;
+    }
+
+    // An affine map with a multiplier coprime to the count is a permutation of the
+    // indices, which spreads neighbouring subtrees apart like the old shuffle did
+    std::mt19937 gen(seed);
+    prefixes.multiplier = bound_order ? 0 : 1;
+    prefixes.offset = 0;
+    prefixes.order.reset();
+    if (prefixes.count > 1 && !bound_order)
+    {
+        std::uniform_int_distribution<long long> pick(1, prefixes.count - 1);
+        do
+        {
+            prefixes.multiplier = pick(gen);
+        } while (gcd(prefixes.multiplier, prefixes.count) != 1);
+        prefixes.offset = pick(gen);
+    }
+    return true;
+}
+
+// Writes the prefix with the given rank (lexicographic order) into `prefix`
+void unrank_prefix(const PrefixEnumerator &prefixes, long long rank, int *prefix)
+{
+    const int n = prefixes.num_cities;
+    const int depth = prefixes.depth;
+
+    // Mixed-radix digits: position k picks among the n - k cities still unused
+    int digits[64];
+    for (int k = depth - 1; k >= 1; k--)
+    {
+        digits[k] = rank % (n - k);
+        rank /= (n - k);
+    }
+
+    uint64_t used = (uint64_t)1 << prefixes.start_city;
+    prefix[0] = prefixes.start_city;
+    for (int k = 1; k < depth; k++)
+    {
+        // Take the digits[k]-th unused city in increasing order
+        int city = -1;
+        int skip = digits[k];
+        do
+        {
+            city++;
+            while ((used >> city) & 1)
+                city++;
+        } while (skip-- > 0);
+        prefix[k] = city;
+        used |= (uint64_t)1 << city;
+    }
+}
+
+// Writes the index-th prefix of the scrambled (or bound) order and returns its length
+int prefix_at(const PrefixEnumerator &prefixes, long long index, int *prefix)
+{
+    long long rank = prefixes.order
+                         ? prefixes.order->ranks[index]
+                         : (long long)(((__int128)index * prefixes.multiplier + prefixes.offset) % prefixes.count);
+    unrank_prefix(prefixes, rank, prefix);
+    return prefixes.depth;
+}
+
+// Ranks the prefixes of a bound order run by the cost of the prefix plus a bound on
+// the rest of the tour, ties by rank. The order depends on the matrix alone, so every
+// MPI rank and every job resuming a checkpoint derives the same indices. The
+// scrambled order is left alone.
+bool order_prefixes_by_bound(PrefixEnumerator &prefixes, const std::vector<int> &distances)
+{
+    if (prefixes.multiplier != 0 || prefixes.order)
+        return true;
+    if (prefixes.count > PREFIX_ORDER_MAX)
+    {
+        std::cerr << "Error: Prefix depth " << prefixes.depth << " yields too many prefixes to order by bound."
+                  << std::endl;
+        return false;
+    }
+    const int n = prefixes.num_cities;
+    const long long count = prefixes.count;
+    // As in the search, symmetric instances only close the tour through cities above
+    // the second one, since the mirror image of every other tour is searched instead
+    bool symmetric = is_symmetric(distances, n);
+    LowerBound shared;
+    init_lower_bound(shared, symmetric ? BOUND_ONE_TREE : BOUND_MIN_EDGE, distances, n, prefixes.start_city);
+    std::vector<int> bounds(count);
+
+#pragma omp parallel
+    {
+        LowerBound bound = shared;
+        std::vector<char> visited(n);
+        int prefix[64];
+#pragma omp for schedule(dynamic, 64)
+        for (long long rank = 0; rank < count; rank++)
+        {
+            unrank_prefix(prefixes, rank, prefix);
+            std::fill(visited.begin(), visited.end(), 0);
+            int cost = 0;
+            for (int k = 0; k < prefixes.depth; k++)
+            {
+                visited[prefix[k]] = 1;
+                if (k > 0)
+                    cost += distances[prefix[k - 1] * n + prefix[k]];
+            }
+            if (prefixes.depth < n)
+            {
+                bound.closing_above = symmetric && prefixes.depth >= 2 ? prefix[1] : -1;
+                bound_reset(bound, visited);
+                cost += bound_remaining(bound, visited, prefix[prefixes.depth - 1], distances, INT_MAX);
+            }
+            else
+            {
+                cost += distances[prefix[n - 1] * n + prefix[0]];
+            }
+            bounds[rank] = cost;
+        }
+    }
+
+    std::shared_ptr<PrefixOrder> order = std::make_shared<PrefixOrder>();
+    order->ranks.resize(count);
+    std::iota(order->ranks.begin(), order->ranks.end(), 0);
+    std::stable_sort(order->ranks.begin(), order->ranks.end(),
+                     [&bounds](int a, int b) { return bounds[a] < bounds[b]; });
+    order->bounds.resize(count);
+    for (long long i = 0; i < count; i++)
+        order->bounds[i] = bounds[order->ranks[i]];
+    prefixes.order = order;
+    return true;
+}
+
+// True if no tour through the index-th prefix can beat `best_distance`. In the bound
+// order this holds for every later index too.
+inline bool prefix_hopeless(const PrefixEnumerator &prefixes, long long index, int best_distance)
+{
+    return prefixes.order && prefixes.order->bounds[index] >= best_distance;
+}
+
+// First index from which every prefix is hopeless, or `count` if there is none (or
+// the order is scrambled)
+long long first_hopeless_prefix(const PrefixEnumerator &prefixes, int best_distance)
+{
+    if (!prefixes.order)
+        return prefixes.count;
+    const std::vector<int> &bounds = prefixes.order->bounds;
+    return std::lower_bound(bounds.begin(), bounds.end(), best_distance) - bounds.begin();
+}
@@ -9,6 +9,7 @@ int min_distance = INT_MAX;
 std::vector<int> min_path;
 
 std::vector<int> distances;
+std::vector<int> neighbors;
 int num_cities;
 
 int main(int argc, char *argv[])
@@ -19,22 +20,16 @@ int main(int argc, char *argv[])
     clock_gettime(CLOCK_MONOTONIC, &global_start);
     clock_gettime(CLOCK_MONOTONIC, &tmp_start);
 
-    std::string input_filename;
-    std::string logs_filename;
-    if (argc == 3)
+    SolverOptions options;
+    if (!parse_options(argc, argv, options))
     {
-        input_filename = argv[1];
-        logs_filename = argv[2];
-    }
-    else
-    {
-        std::cout << "Usage: " << argv[0] << " <input_data_filename> <logs_filename>" << std::endl;
+        print_usage(argv[0]);
         return 0;
     }
-
-    // Clear logs file
-    std::ofstream logs_file(logs_filename, std::ios::out);
-    logs_file.close();
+    AnytimeLimits limits;
+    anytime_init(limits, options.time_limit, options.gap);
+    std::string input_filename = options.input_filename;
+    std::string logs_filename = options.logs_filename;
 
     // Get hostname
     std::string hostname;
@@ -50,63 +45,153 @@ int main(int argc, char *argv[])
         hostname = "Unknown";
     }
 
-    // Setup: read input file
-    num_cities = read_tsplib_matrix(input_filename, distances);
+    // Buffer phase events per thread and write them out in bulk
+    trace_init(logs_filename, hostname, options.trace_format, options.trace_sample, true);
+    stats_init(options.stats, 0);
+
+    // Batch mode: solve every instance of the manifest in this process
+    if (options.batch)
+    {
+        int status = batch_run(options, 1, 0);
+        trace_finish();
+        return status;
+    }
+
+    // Setup: read input file. The heuristic keeps coordinates as they are and
+    // computes distances on demand instead of storing the matrix.
+    TspInstance instance;
+    if (options.solver == SOLVER_HEURISTIC)
+    {
+        num_cities = read_tsplib_instance(input_filename, instance, true);
+        if (num_cities > 0 && !heuristic_supported(instance))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        num_cities = read_tsplib_matrix(input_filename, distances, solver_cities_supported(options.solver));
+    }
+    if (num_cities == 0)
+    {
+        return 1;
+    }
 
     // Set starting city
     int first_city = 0;
 
-    // Create all possible pre-paths to be explored and shuffle them
-    std::vector<std::vector<int>> paths;
-    create_paths(paths, first_city, num_cities);
-
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::shuffle(paths.begin(), paths.end(), gen);
+    // Enumerate the pre-paths to be explored lazily, in a random or bound order
+    PrefixEnumerator prefixes;
+    if (options.solver == SOLVER_BRANCH_AND_BOUND)
+    {
+        std::random_device rd;
+        if (!init_prefixes(prefixes, num_cities, first_city, options.prefix_depth, 1, rd(),
+                           options.prefix_order == ORDER_BOUND))
+        {
+            return 1;
+        }
+    }
 
-    clock_gettime(CLOCK_MONOTONIC, &tmp_end);
-    tmp_start_seconds = tmp_start.tv_sec + tmp_start.tv_nsec / 1e9;
-    tmp_end_seconds = tmp_end.tv_sec + tmp_end.tv_nsec / 1e9;
-    log_event(logs_filename, "SETUP", hostname, 0, tmp_start_seconds, tmp_end_seconds);
+    // Resume from the checkpoint of an earlier job, if there is one, then rank the
+    // prefixes if they go in bound order
+    Checkpoint checkpoint;
+    if (options.solver == SOLVER_BRANCH_AND_BOUND &&
+        (!checkpoint_open(checkpoint, options.checkpoint_filename, options.checkpoint_interval, distances, num_cities) ||
+         !checkpoint_attach(checkpoint, prefixes, options.prefix_depth) ||
+         !order_prefixes_by_bound(prefixes, distances)))
+    {
+        return 1;
+    }
 
-    // Compute initial minimum distance and path
-    clock_gettime(CLOCK_MONOTONIC, &tmp_start);
-    std::pair<std::vector<int>, int> result = nearest_neighbor_tsp(distances, num_cities);
-    std::vector<int> initial_path = result.first;
-    int initial_distance = result.second;
-    min_distance = initial_distance;
-    min_path = initial_path;
     clock_gettime(CLOCK_MONOTONIC, &tmp_end);
     tmp_start_seconds = tmp_start.tv_sec + tmp_start.tv_nsec / 1e9;
     tmp_end_seconds = tmp_end.tv_sec + tmp_end.tv_nsec / 1e9;
-    log_event(logs_filename, "COMPUTATION", hostname, 0, tmp_start_seconds, tmp_end_seconds);
+    trace_event(TRACE_SETUP, 0, tmp_start_seconds, tmp_end_seconds);
 
-    // Explore all possible pre-paths
-    clock_gettime(CLOCK_MONOTONIC, &tmp_start);
-    for (int i = 0; i < (int)paths.size(); i++)
+    if (options.solver == SOLVER_HELD_KARP)
     {
-
-        std::vector<int> path = paths[i];
-        std::vector<int> visited(num_cities, false);
-        int curr_distance = 0;
-
-        // Initialize the curr-distance and visited vector for the current pre-path
-        for (int j = 0; j < (int)path.size(); j++)
+        // Solve exactly with the bitmask dynamic program
+        clock_gettime(CLOCK_MONOTONIC, &tmp_start);
+        std::pair<std::vector<int>, int> result = held_karp_tsp(distances, num_cities);
+        min_path = result.first;
+        min_distance = result.second;
+        clock_gettime(CLOCK_MONOTONIC, &tmp_end);
+        tmp_start_seconds = tmp_start.tv_sec + tmp_start.tv_nsec / 1e9;
+        tmp_end_seconds = tmp_end.tv_sec + tmp_end.tv_nsec / 1e9;
+        trace_event(TRACE_COMPUTATION, 0, tmp_start_seconds, tmp_end_seconds);
+    }
+    else if (options.solver == SOLVER_HEURISTIC)
+    {
+        // Improve tours with chained Lin-Kernighan until the kicks or the time limit run out
+        clock_gettime(CLOCK_MONOTONIC, &tmp_start);
+        std::random_device rd;
+        std::pair<std::vector<int>, int> result = heuristic_tour(instance, first_city, 0, 1, 1, rd(), limits);
+        min_path = result.first;
+        min_distance = result.second;
+        clock_gettime(CLOCK_MONOTONIC, &tmp_end);
+        tmp_start_seconds = tmp_start.tv_sec + tmp_start.tv_nsec / 1e9;
+        tmp_end_seconds = tmp_end.tv_sec + tmp_end.tv_nsec / 1e9;
+        trace_event(TRACE_COMPUTATION, 0, tmp_start_seconds, tmp_end_seconds);
+    }
+    else
+    {
+        // Compute initial minimum distance and path: best locally improved multi-start tour
+        clock_gettime(CLOCK_MONOTONIC, &tmp_start);
+        build_neighbor_lists(distances, num_cities, neighbors);
+        std::pair<std::vector<int>, int> result = initial_tour(distances, neighbors, num_cities, first_city, 0, 1);
+        checkpoint_seed_tour(checkpoint, result);
+        LowerBound bound;
+        init_lower_bound(bound, options.bound, distances, num_cities, first_city);
+        Incumbent incumbent;
+        init_incumbent(incumbent, result, num_cities);
+        DominanceMemo memo;
+        init_memo(memo, options.memo_megabytes);
+        SearchContext search;
+        init_search(search, distances, neighbors, num_cities, bound, incumbent);
+        attach_memo(search, memo);
+        attach_limits(search, limits);
+        anytime_attach(limits, prefixes, bound, distances, incumbent, checkpoint);
+        anytime_publish(limits, result.second, result.first.data(), num_cities);
+        SearchPrefixFn search_prefix = search_prefix_for(num_cities);
+        if (search_prefix == nullptr)
+        {
+            return 1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &tmp_end);
+        tmp_start_seconds = tmp_start.tv_sec + tmp_start.tv_nsec / 1e9;
+        tmp_end_seconds = tmp_end.tv_sec + tmp_end.tv_nsec / 1e9;
+        trace_event(TRACE_COMPUTATION, 0, tmp_start_seconds, tmp_end_seconds);
+
+        // Explore all possible pre-paths
+        clock_gettime(CLOCK_MONOTONIC, &tmp_start);
+        stats_begin_search();
+        int prefix[KERNEL_MAX_CITIES];
+        std::vector<SavedStack> stacks;
+        for (long long i = 0; i < prefixes.count; i++)
         {
-            if (j < (int)path.size() - 1)
+            if (checkpoint_done(checkpoint, i) || drop_hopeless_prefix(prefixes, i, incumbent, checkpoint, limits))
+                continue;
+            int prefix_length = prefix_at(prefixes, i, prefix);
+            checkpoint_stacks(checkpoint, i, stacks);
+            search_prefix(search, prefix, prefix_length, &stacks);
+            if (anytime_stopped(limits))
             {
-                curr_distance += get_distance(path[j], path[j + 1], distances, num_cities);
+                checkpoint_stop(checkpoint, i, stacks); // The prefix was cut short
+                break;
             }
-            visited[path[j]] = true;
+            checkpoint_mark(checkpoint, i);
+            anytime_mark(limits, i);
+            checkpoint_tick(checkpoint, incumbent);
         }
-
-        // Explore the current pre-path
-        dfs(path, visited, curr_distance, min_distance, min_path, distances, num_cities);
+        stats_end_search();
+        stats_add_search(search, 0);
+        checkpoint_finish(checkpoint, incumbent, !anytime_stopped(limits));
+        min_distance = incumbent_read(incumbent, min_path);
+        clock_gettime(CLOCK_MONOTONIC, &tmp_end);
+        tmp_start_seconds = tmp_start.tv_sec + tmp_start.tv_nsec / 1e9;
+        tmp_end_seconds = tmp_end.tv_sec + tmp_end.tv_nsec / 1e9;
+        trace_event(TRACE_COMPUTATION, 0, tmp_start_seconds, tmp_end_seconds);
     }
-    clock_gettime(CLOCK_MONOTONIC, &tmp_end);
-    tmp_start_seconds = tmp_start.tv_sec + tmp_start.tv_nsec / 1e9;
-    tmp_end_seconds = tmp_end.tv_sec + tmp_end.tv_nsec / 1e9;
-    log_event(logs_filename, "COMPUTATION", hostname, 0, tmp_start_seconds, tmp_end_seconds);
 
     clock_gettime(CLOCK_MONOTONIC, &global_end);
     double elapsed_time = global_end.tv_sec + global_end.tv_nsec / 1e9 - global_start.tv_sec - global_start.tv_nsec / 1e9;
@@ -121,7 +206,10 @@ int main(int argc, char *argv[])
         std::cout << min_path[i] + 1 << ", ";
     }
     std::cout << std::endl;
+    anytime_print(limits, min_distance, options.solver != SOLVER_HEURISTIC);
     std::cout << "---------------------------------------------" << std::endl;
 
+    trace_finish();
+    stats_finish();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <mutex>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// Search statistics for --stats: per-worker node, prune and improvement counts, idle
+// time, and hardware counters per phase. Counters are read whenever a traced phase
+// ends, so each reading covers that phase plus the bookkeeping just before it; a
+// thread's counters start at its first phase. Everything is kept per thread and only
+// merged (and across ranks, gathered) at exit.
+
+enum PerfCounter
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTERS
+};
+
+const int STATS_PHASES = 4; // One per TraceAction
+const int STATS_MAX_DEPTH = KERNEL_MAX_CITIES + 1;
+
+// Plain data, so ranks can ship it as bytes
+struct WorkerStats
+{
+    int rank;
+    int worker_id;
+    int perf_available;
+    long long nodes;
+    long long pruned;
+    long long improvements;
+    double idle_seconds; // Search window not spent computing or orchestrating; < 0 if not a search worker
+    double phase_seconds[STATS_PHASES];
+    long long phase_events[STATS_PHASES];
+    long long phase_counters[STATS_PHASES][PERF_COUNTERS];
+};
+
+struct ImprovementRecord
+{
+    double time; // Seconds since stats_init() of its process
+    int distance;
+    int rank;
+    int worker_id;
+};
+
+// Counters of one thread. A thread can log phases under more than one worker id
+// (hybrid ranks log setup under the rank), so it keeps one entry per id.
+struct ThreadStats
+{
+    int perf_fd = -1; // Group leader, or -1 if hardware counters are unavailable
+    int perf_slots[PERF_COUNTERS];
+    int perf_opened = 0;
+    long long last_reading[PERF_COUNTERS] = {};
+    std::vector<WorkerStats> workers;
+};
+
+struct StatsReport
+{
+    std::vector<WorkerStats> workers;
+    std::vector<ImprovementRecord> improvements;
+    long long depth_nodes[STATS_MAX_DEPTH];
+    long long depth_pruned[STATS_MAX_DEPTH];
+    long long memo_counts[MEMO_COUNTERS];
+};
+
+struct StatsState
+{
+    bool enabled = false;
+    int rank = 0;
+    double start_time = 0;
+    double search_start = 0;
+    double search_end = 0;
+    std::mutex mutex;
+    std::vector<ThreadStats *> threads;
+    StatsReport searches; // Search counters handed in by the drivers
+};
+
+StatsState stats_state;
+thread_local ThreadStats *thread_stats = nullptr;
+
+double stats_clock()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+WorkerStats &stats_worker(std::vector<WorkerStats> &workers, int rank, int worker_id)
+{
+    for (WorkerStats &worker : workers)
+    {
+        if (worker.rank == rank && worker.worker_id == worker_id)
+            return worker;
+    }
+    WorkerStats worker;
+    memset(&worker, 0, sizeof(worker));
+    worker.rank = rank;
+    worker.worker_id = worker_id;
+    worker.idle_seconds = -1;
+    workers.push_back(worker);
+    return workers.back();
+}
+
+// Opens cycles, instructions, cache misses and branch misses of the calling thread as
+// one group, so they are read together. Members the CPU lacks are left out.
+void stats_open_counters(ThreadStats &thread)
+{
+    const uint64_t configs[PERF_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                             PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (int c = 0; c < PERF_COUNTERS; c++)
+    {
+        thread.perf_slots[c] = -1;
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[c];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.disabled = thread.perf_fd < 0;
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, thread.perf_fd, 0);
+        if (fd < 0)
+            continue;
+        if (thread.perf_fd < 0)
+            thread.perf_fd = fd;
+        thread.perf_slots[c] = thread.perf_opened++;
+    }
+    if (thread.perf_fd >= 0)
+        ioctl(thread.perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void stats_read_counters(ThreadStats &thread, long long *reading)
+{
+    uint64_t values[1 + PERF_COUNTERS] = {};
+    if (thread.perf_fd < 0 || read(thread.perf_fd, values, sizeof(values)) < 0)
+        return;
+    for (int c = 0; c < PERF_COUNTERS; c++)
+        reading[c] = thread.perf_slots[c] >= 0 ? (long long)values[1 + thread.perf_slots[c]] : 0;
+}
+
+ThreadStats &stats_thread()
+{
+    if (thread_stats == nullptr)
+    {
+        thread_stats = new ThreadStats();
+        stats_open_counters(*thread_stats);
+        stats_read_counters(*thread_stats, thread_stats->last_reading);
+        std::lock_guard<std::mutex> lock(stats_state.mutex);
+        stats_state.threads.push_back(thread_stats);
+    }
+    return *thread_stats;
+}
+
+// Installed as trace_phase_hook: one counter read per phase, no locks
+void stats_phase(TraceAction action, int worker_id, double start_time, double end_time)
+{
+    ThreadStats &thread = stats_thread();
+    WorkerStats &worker = stats_worker(thread.workers, stats_state.rank, worker_id);
+    worker.phase_seconds[action] += end_time - start_time;
+    worker.phase_events[action]++;
+    if (thread.perf_fd >= 0)
+    {
+        long long reading[PERF_COUNTERS];
+        stats_read_counters(thread, reading);
+        for (int c = 0; c < PERF_COUNTERS; c++)
+        {
+            worker.phase_counters[action][c] += reading[c] - thread.last_reading[c];
+            thread.last_reading[c] = reading[c];
+        }
+        worker.perf_available = 1;
+    }
+}
+
+void stats_init(bool enabled, int rank)
+{
+    stats_state.enabled = enabled;
+    stats_state.rank = rank;
+    if (!enabled)
+        return;
+    stats_state.start_time = stats_clock();
+    stats_thread(); // Count the setup of the main thread too
+    trace_phase_hook = stats_phase;
+}
+
+// Brackets the parallel search; idle time is measured against this window
+void stats_begin_search()
+{
+    stats_state.search_start = stats_clock();
+}
+
+void stats_end_search()
+{
+    stats_state.search_end = stats_clock();
+}
+
+// Hands in the counters of one search context once it is done searching
+void stats_add_search(const SearchContext &search, int worker_id)
+{
+    if (!stats_state.enabled)
+        return;
+    std::lock_guard<std::mutex> lock(stats_state.mutex);
+    StatsReport &searches = stats_state.searches;
+    WorkerStats &worker = stats_worker(searches.workers, stats_state.rank, worker_id);
+    for (int d = 0; d < STATS_MAX_DEPTH; d++)
+    {
+        worker.nodes += search.nodes[d];
+        worker.pruned += search.pruned[d];
+        searches.depth_nodes[d] += search.nodes[d];
+        searches.depth_pruned[d] += search.pruned[d];
+    }
+    for (int c = 0; c < MEMO_COUNTERS; c++)
+    {
+        searches.memo_counts[c] += search.memo_counts[c];
+    }
+    worker.improvements += search.improvements.size();
+    for (const TourImprovement &improvement : search.improvements)
+    {
+        searches.improvements.push_back({improvement.time - stats_state.start_time, improvement.distance,
+                                         stats_state.rank, worker_id});
+    }
+}
+
+// Merges the phase counters of every thread with the search counters of this process.
+// Call once no thread is searching or tracing anymore.
+void stats_report(StatsReport &report)
+{
+    std::lock_guard<std::mutex> lock(stats_state.mutex);
+    report = stats_state.searches;
+    for (ThreadStats *thread : stats_state.threads)
+    {
+        for (const WorkerStats &phases : thread->workers)
+        {
+            WorkerStats &worker = stats_worker(report.workers, phases.rank, phases.worker_id);
+            worker.perf_available |= phases.perf_available;
+            for (int p = 0; p < STATS_PHASES; p++)
+            {
+                worker.phase_seconds[p] += phases.phase_seconds[p];
+                worker.phase_events[p] += phases.phase_events[p];
+                for (int c = 0; c < PERF_COUNTERS; c++)
+                    worker.phase_counters[p][c] += phases.phase_counters[p][c];
+            }
+        }
+    }
+
+    // Only workers that searched or coordinated during the window can be idle in it
+    double window = stats_state.search_end - stats_state.search_start;
+    for (WorkerStats &worker : report.workers)
+    {
+        double busy = worker.phase_seconds[TRACE_COMPUTATION] + worker.phase_seconds[TRACE_ORCHESTRATION];
+        if (worker.nodes > 0 || worker.phase_events[TRACE_ORCHESTRATION] > 0)
+            worker.idle_seconds = std::max(0.0, window - busy);
+    }
+    std::sort(report.workers.begin(), report.workers.end(), [](const WorkerStats &a, const WorkerStats &b) {
+        return a.rank != b.rank ? a.rank < b.rank : a.worker_id < b.worker_id;
+    });
+    std::sort(report.improvements.begin(), report.improvements.end(),
+              [](const ImprovementRecord &a, const ImprovementRecord &b) { return a.time < b.time; });
+}
+
+void stats_print(const StatsReport &report)
+{
+    printf("Search statistics\n");
+    printf("%5s %7s %14s %14s %8s %10s %10s\n", "rank", "worker", "nodes", "pruned", "improved", "busy s", "idle s");
+    WorkerStats total;
+    memset(&total, 0, sizeof(total));
+    for (const WorkerStats &worker : report.workers)
+    {
+        double busy = worker.phase_seconds[TRACE_COMPUTATION] + worker.phase_seconds[TRACE_ORCHESTRATION];
+        printf("%5d %7d %14lld %14lld %8lld %10.3f", worker.rank, worker.worker_id, worker.nodes, worker.pruned,
+               worker.improvements, busy);
+        if (worker.idle_seconds >= 0)
+            printf(" %10.3f\n", worker.idle_seconds);
+        else
+            printf(" %10s\n", "-");
+        total.nodes += worker.nodes;
+        total.pruned += worker.pruned;
+        total.improvements += worker.improvements;
+        total.idle_seconds += std::max(0.0, worker.idle_seconds);
+        total.perf_available |= worker.perf_available;
+        for (int p = 0; p < STATS_PHASES; p++)
+        {
+            total.phase_seconds[p] += worker.phase_seconds[p];
+            total.phase_events[p] += worker.phase_events[p];
+            for (int c = 0; c < PERF_COUNTERS; c++)
+                total.phase_counters[p][c] += worker.phase_counters[p][c];
+        }
+    }
+    printf("%13s %14lld %14lld %8lld %10.3f %10.3f\n", "total", total.nodes, total.pruned, total.improvements,
+           total.phase_seconds[TRACE_COMPUTATION] + total.phase_seconds[TRACE_ORCHESTRATION], total.idle_seconds);
+
+    printf("%5s %14s %14s %7s\n", "depth", "nodes", "pruned", "pruned");
+    for (int d = 0; d < STATS_MAX_DEPTH; d++)
+    {
+        if (report.depth_nodes[d] > 0)
+            printf("%5d %14lld %14lld %6.1f%%\n", d, report.depth_nodes[d], report.depth_pruned[d],
+                   100.0 * report.depth_pruned[d] / report.depth_nodes[d]);
+    }
+
+    const long long *memo = report.memo_counts;
+    if (memo[MEMO_PROBES] > 0)
+    {
+        printf("Dominance memo\n");
+        for (int c = 0; c < MEMO_COUNTERS; c++)
+            printf("%10s %14lld\n", MEMO_COUNTER_NAMES[c], memo[c]);
+        printf("%10s %13.1f%%\n", "hit rate", 100.0 * memo[MEMO_HITS] / memo[MEMO_PROBES]);
+    }
+
+    printf("Incumbent improvements\n");
+    printf("%10s %10s %5s %7s\n", "time s", "distance", "rank", "worker");
+    for (const ImprovementRecord &improvement : report.improvements)
+        printf("%10.4f %10d %5d %7d\n", improvement.time, improvement.distance, improvement.rank, improvement.worker_id);
+
+    printf("%-14s %8s %10s %14s %14s %5s %12s %12s\n", "phase", "events", "seconds", "cycles", "instructions",
+           "IPC", "cache-miss", "branch-miss");
+    for (int p = 0; p < STATS_PHASES; p++)
+    {
+        if (total.phase_events[p] == 0)
+            continue;
+        const long long *counters = total.phase_counters[p];
+        printf("%-14s %8lld %10.3f", TRACE_ACTION_NAMES[p], total.phase_events[p], total.phase_seconds[p]);
+        if (total.perf_available)
+            printf(" %14lld %14lld %5.2f %12lld %12lld\n", counters[PERF_CYCLES], counters[PERF_INSTRUCTIONS],
+                   counters[PERF_CYCLES] > 0 ? (double)counters[PERF_INSTRUCTIONS] / counters[PERF_CYCLES] : 0.0,
+                   counters[PERF_CACHE_MISSES], counters[PERF_BRANCH_MISSES]);
+        else
+            printf(" %14s\n", "(hardware counters unavailable)");
+    }
+    fflush(stdout);
+}
+
+// Prints the summary of a single-process run
+void stats_finish()
+{
+    if (!stats_state.enabled)
+        return;
+    StatsReport report;
+    stats_report(report);
+    stats_print(report);
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <atomic>
+#include <omp.h>
+
+// Task-parallel branch and bound for the OpenMP build. Every prefix becomes a task
+// running the kernel's stack in slices of TASK_SLICE_NODES nodes. Between slices, a
+// task that finds the team short of queued work hands half of its oldest branches to
+// a new task with stack_split(), so a thread that runs out of prefixes picks up
+// pieces of the large subtrees still being searched instead of idling at a barrier.
+
+// Frames with fewer unvisited cities than this are never split off
+const int TASK_MIN_REMAINING_CITIES = 6;
+// Keep about this many queued tasks per thread before splitting stops
+const int TASKS_PER_THREAD = 4;
+// Children a task examines between checks for idle threads
+const long long TASK_SLICE_NODES = 1 << 15;
+
+struct TaskControl
+{
+    std::atomic<int> pending; // Tasks created but not finished yet
+    int max_pending;
+    int max_split_depth; // Deepest path length whose frames may be split off
+};
+
+void init_task_control(TaskControl &control, int num_cities, int prefix_depth, int num_threads)
+{
+    control.pending.store(0);
+    control.max_pending = TASKS_PER_THREAD * num_threads;
+    control.max_split_depth = std::max(prefix_depth, num_cities - TASK_MIN_REMAINING_CITIES);
+}
+
+// `contexts` holds one SearchContext per thread. Tasks are tied, so a task always
+// runs on the same thread, but other tasks may borrow that thread's context at every
+// task creation point; stack_run() therefore rebuilds the bound sums on every slice.
+// A stopped task adds its stack to `stopped`, if given.
+template <int N>
+void task_run(SearchContext *contexts, SearchStack<N> &stack, TaskControl &control, std::vector<SavedStack> *stopped)
+{
+    while (true)
+    {
+        SearchContext &search = contexts[omp_get_thread_num()];
+        if (stack_run(search, stack, TASK_SLICE_NODES))
+            break;
+        if (search.limits != nullptr && anytime_stopped(*search.limits))
+        {
+            if (stopped != nullptr)
+            {
+                SavedStack saved;
+                stack_save(stack, saved);
+#pragma omp critical(task_stopped)
+                stopped->push_back(saved);
+            }
+            break;
+        }
+
+        // Give idle threads the oldest branches, which hold the most work
+        SearchStack<N> donated;
+        while (control.pending.load(std::memory_order_relaxed) < control.max_pending &&
+               stack_split(stack, donated, control.max_split_depth))
+        {
+            control.pending.fetch_add(1, std::memory_order_relaxed);
+#pragma omp task firstprivate(donated, stopped) shared(control)
+            {
+                task_run<N>(contexts, donated, control, stopped);
+                control.pending.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+    }
+#pragma omp taskwait
+}
+
+// Task-parallel search_prefix_n(): `stacks` likewise holds the stacks to continue, each
+// becoming a task, and is left with those of the tasks that were stopped
+template <int N>
+void search_prefix_tasks_n(SearchContext *contexts, const int *prefix, int prefix_length, TaskControl &control,
+                           std::vector<SavedStack> *stacks)
+{
+    typedef typename KernelTraits<N>::Mask Mask;
+    SearchContext &search = contexts[omp_get_thread_num()];
+    const int n = N > 0 ? N : search.num_cities;
+    if (stacks != nullptr && !stacks->empty())
+    {
+        std::vector<SavedStack> resumed;
+        resumed.swap(*stacks);
+        for (size_t k = 0; k < resumed.size(); k++)
+        {
+            control.pending.fetch_add(1, std::memory_order_relaxed);
+#pragma omp task firstprivate(k, stacks) shared(control, resumed)
+            {
+                SearchStack<N> stack;
+                stack_load(stack, resumed[k]);
+                task_run<N>(contexts, stack, control, stacks);
+                control.pending.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+#pragma omp taskwait
+        return;
+    }
+
+    KernelState<N> state;
+    state.visited = 0;
+    int curr_distance = 0;
+    for (int j = 0; j < prefix_length; j++)
+    {
+        state.path[j] = prefix[j];
+        state.visited |= (Mask)1 << prefix[j];
+        if (j > 0)
+            curr_distance += search.matrix[prefix[j - 1] * n + prefix[j]];
+    }
+    if (!orientation_allowed<N>(search, state, prefix_length) ||
+        path_dominated(search, state.visited, state.path, prefix_length, curr_distance))
+        return;
+    SearchStack<N> stack;
+    stack_init(stack, search, state, prefix_length, curr_distance);
+    task_run<N>(contexts, stack, control, stacks);
+}
+
+typedef void (*SearchPrefixTasksFn)(SearchContext *, const int *, int, TaskControl &, std::vector<SavedStack> *);
+
+const SearchPrefixTasksFn SEARCH_PREFIX_TASKS_TABLE[KERNEL_MAX_SPECIALIZED - KERNEL_MIN_SPECIALIZED + 1] = {
+    search_prefix_tasks_n<8>, search_prefix_tasks_n<9>, search_prefix_tasks_n<10>, search_prefix_tasks_n<11>,
+    search_prefix_tasks_n<12>, search_prefix_tasks_n<13>, search_prefix_tasks_n<14>, search_prefix_tasks_n<15>,
+    search_prefix_tasks_n<16>, search_prefix_tasks_n<17>, search_prefix_tasks_n<18>, search_prefix_tasks_n<19>,
+    search_prefix_tasks_n<20>, search_prefix_tasks_n<21>, search_prefix_tasks_n<22>, search_prefix_tasks_n<23>,
+    search_prefix_tasks_n<24>, search_prefix_tasks_n<25>, search_prefix_tasks_n<26>, search_prefix_tasks_n<27>,
+    search_prefix_tasks_n<28>, search_prefix_tasks_n<29>, search_prefix_tasks_n<30>, search_prefix_tasks_n<31>,
+    search_prefix_tasks_n<32>};
+
+// Task-parallel counterpart of search_prefix_for()
+SearchPrefixTasksFn search_prefix_tasks_for(int num_cities)
+{
+    if (num_cities >= KERNEL_MIN_SPECIALIZED && num_cities <= KERNEL_MAX_SPECIALIZED)
+    {
+        return SEARCH_PREFIX_TASKS_TABLE[num_cities - KERNEL_MIN_SPECIALIZED];
+    }
+    if (num_cities <= KERNEL_MAX_CITIES)
+    {
+        return search_prefix_tasks_n<0>;
+    }
+    return nullptr;
+}
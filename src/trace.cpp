@@ -0,0 +1,189 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// Phase timestamps used to go straight to the logs file, one open/format/close per
+// event and unsynchronized across threads. They are now appended to a per-thread
+// buffer owned by a single writer (so no locks or atomics on the hot path) and
+// written out a whole buffer at a time with one write() on an O_APPEND descriptor.
+
+enum TraceAction
+{
+    TRACE_SETUP,
+    TRACE_COMPUTATION,
+    TRACE_COMMUNICATION,
+    TRACE_ORCHESTRATION
+};
+
+const char *const TRACE_ACTION_NAMES[] = {"SETUP", "COMPUTATION", "COMMUNICATION", "ORCHESTRATION"};
+
+enum TraceFormat
+{
+    TRACE_CSV,   // ACTION,hostname,thread_id,start,end lines, as read by scripts/visualize_results.py
+    TRACE_BINARY // TraceBlockHeader + TraceRecords, converted by scripts/trace_to_csv.py
+};
+
+const int TRACE_BUFFER_RECORDS = 4096;
+const int TRACE_HOSTNAME_LENGTH = 64;
+const char TRACE_MAGIC[4] = {'T', 'R', 'C', '1'};
+
+struct TraceRecord
+{
+    double start_time;
+    double end_time;
+    int32_t worker_id;
+    int32_t action;
+};
+
+struct TraceBlockHeader
+{
+    char magic[4];
+    uint32_t record_count;
+    char hostname[TRACE_HOSTNAME_LENGTH];
+};
+
+struct TraceBuffer
+{
+    TraceRecord records[TRACE_BUFFER_RECORDS];
+    int count = 0;
+    unsigned long long events_seen = 0; // Drives sampling
+};
+
+struct TraceState
+{
+    int fd = -1;
+    std::string hostname;
+    TraceFormat format = TRACE_CSV;
+    int sample_period = 1;
+    std::mutex registry_mutex;
+    std::vector<TraceBuffer *> buffers;
+};
+
+TraceState trace_state;
+thread_local TraceBuffer *trace_buffer = nullptr;
+
+// Optional observer of every phase, sampled or not (the --stats counters)
+void (*trace_phase_hook)(TraceAction action, int worker_id, double start_time, double end_time) = nullptr;
+
+// Opens the logs file; only one process of a run should truncate it
+void trace_init(const std::string &filename, const std::string &hostname, TraceFormat format, int sample_period, bool truncate)
+{
+    int flags = O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0);
+    trace_state.fd = open(filename.c_str(), flags, 0644);
+    if (trace_state.fd < 0)
+    {
+        std::cerr << "Error: Unable to open logs file." << std::endl;
+    }
+    trace_state.hostname = hostname;
+    trace_state.format = format;
+    trace_state.sample_period = sample_period > 0 ? sample_period : 1;
+}
+
+void trace_write_buffer(TraceBuffer &buffer)
+{
+    if (buffer.count == 0 || trace_state.fd < 0)
+    {
+        buffer.count = 0;
+        return;
+    }
+
+    std::vector<char> block;
+    if (trace_state.format == TRACE_BINARY)
+    {
+        TraceBlockHeader header;
+        memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+        header.record_count = buffer.count;
+        memset(header.hostname, 0, sizeof(header.hostname));
+        strncpy(header.hostname, trace_state.hostname.c_str(), sizeof(header.hostname) - 1);
+        block.resize(sizeof(header) + buffer.count * sizeof(TraceRecord));
+        memcpy(block.data(), &header, sizeof(header));
+        memcpy(block.data() + sizeof(header), buffer.records, buffer.count * sizeof(TraceRecord));
+    }
+    else
+    {
+        char line[160];
+        block.reserve(buffer.count * 64);
+        for (int i = 0; i < buffer.count; i++)
+        {
+            const TraceRecord &record = buffer.records[i];
+            int length = snprintf(line, sizeof(line), "%s,%s,%d,%.8f,%.8f\n",
+                                  TRACE_ACTION_NAMES[record.action], trace_state.hostname.c_str(),
+                                  record.worker_id, record.start_time, record.end_time);
+            block.insert(block.end(), line, line + length);
+        }
+    }
+
+    // A single write() per block keeps blocks from different threads and ranks whole
+    if (write(trace_state.fd, block.data(), block.size()) < 0)
+    {
+        std::cerr << "Error: Unable to write logs file." << std::endl;
+    }
+    buffer.count = 0;
+}
+
+TraceBuffer &trace_thread_buffer()
+{
+    if (trace_buffer == nullptr)
+    {
+        trace_buffer = new TraceBuffer();
+        std::lock_guard<std::mutex> lock(trace_state.registry_mutex);
+        trace_state.buffers.push_back(trace_buffer);
+    }
+    return *trace_buffer;
+}
+
+// Timestamp for events of the MPI builds. Unlike MPI_Wtime() it may be read by any
+// thread while another one is inside MPI (MPI_THREAD_SERIALIZED).
+double trace_clock()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// Records one event of the calling thread. Apart from SETUP, only one in every
+// sample_period events of a thread is kept, so tracing cannot dominate a run.
+void trace_event(TraceAction action, int worker_id, double start_time, double end_time)
+{
+    if (trace_phase_hook != nullptr)
+    {
+        trace_phase_hook(action, worker_id, start_time, end_time);
+    }
+    TraceBuffer &buffer = trace_thread_buffer();
+    if (action != TRACE_SETUP && buffer.events_seen++ % trace_state.sample_period != 0)
+    {
+        return;
+    }
+
+    TraceRecord &record = buffer.records[buffer.count++];
+    record.start_time = start_time;
+    record.end_time = end_time;
+    record.worker_id = worker_id;
+    record.action = action;
+    if (buffer.count == TRACE_BUFFER_RECORDS)
+    {
+        trace_write_buffer(buffer);
+    }
+}
+
+// Writes out every thread's pending events. Call once no thread is tracing anymore.
+void trace_finish()
+{
+    std::lock_guard<std::mutex> lock(trace_state.registry_mutex);
+    for (TraceBuffer *buffer : trace_state.buffers)
+    {
+        trace_write_buffer(*buffer);
+    }
+    if (trace_state.fd >= 0)
+    {
+        close(trace_state.fd);
+        trace_state.fd = -1;
+    }
+}
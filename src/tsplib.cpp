@@ -0,0 +1,469 @@
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// TSPLIB loader. The file is mapped read-only and scanned in place with hand-rolled
+// number parsers, so large instances load at I/O speed instead of iostream speed.
+// Explicit matrices in every EDGE_WEIGHT_FORMAT and NODE_COORD_SECTION instances with
+// EUC_2D, CEIL_2D, GEO and ATT weights are supported.
+
+enum TsplibWeightType
+{
+    WEIGHT_EXPLICIT,
+    WEIGHT_EUC_2D,
+    WEIGHT_CEIL_2D,
+    WEIGHT_GEO,
+    WEIGHT_ATT
+};
+
+enum TsplibWeightFormat
+{
+    FORMAT_FULL_MATRIX,
+    FORMAT_UPPER_ROW,      // Strictly above the diagonal, row by row
+    FORMAT_LOWER_ROW,      // Strictly below the diagonal, row by row
+    FORMAT_UPPER_DIAG_ROW, // Diagonal included
+    FORMAT_LOWER_DIAG_ROW
+};
+
+struct TsplibScanner
+{
+    const char *cursor;
+    const char *end;
+};
+
+struct MappedFile
+{
+    const char *data = nullptr;
+    size_t size = 0;
+};
+
+bool map_file(const std::string &filename, MappedFile &file)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    file.size = info.st_size;
+    if (file.size > 0)
+    {
+        void *data = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            return false;
+        }
+        madvise(data, file.size, MADV_SEQUENTIAL);
+        file.data = static_cast<const char *>(data);
+    }
+    close(fd); // The mapping stays valid
+    return true;
+}
+
+void unmap_file(MappedFile &file)
+{
+    if (file.data != nullptr)
+        munmap(const_cast<char *>(file.data), file.size);
+    file.data = nullptr;
+}
+
+inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Reads the next line (without its terminator) and advances past it
+bool scan_line(TsplibScanner &scanner, const char *&begin, const char *&finish)
+{
+    if (scanner.cursor >= scanner.end)
+        return false;
+    begin = scanner.cursor;
+    const char *newline = static_cast<const char *>(memchr(begin, '\n', scanner.end - begin));
+    finish = newline != nullptr ? newline : scanner.end;
+    scanner.cursor = newline != nullptr ? newline + 1 : scanner.end;
+    while (finish > begin && is_space(finish[-1]))
+        finish--;
+    while (begin < finish && is_space(*begin))
+        begin++;
+    return true;
+}
+
+bool scan_int(TsplibScanner &scanner, long long &value)
+{
+    const char *p = scanner.cursor;
+    while (p < scanner.end && is_space(*p))
+        p++;
+    bool negative = p < scanner.end && *p == '-';
+    if (p < scanner.end && (*p == '-' || *p == '+'))
+        p++;
+    if (p >= scanner.end || *p < '0' || *p > '9')
+        return false;
+    long long result = 0;
+    while (p < scanner.end && *p >= '0' && *p <= '9')
+        result = result * 10 + (*p++ - '0');
+    scanner.cursor = p;
+    value = negative ? -result : result;
+    return true;
+}
+
+// Decimal number with optional fraction and exponent, as used for coordinates
+bool scan_double(TsplibScanner &scanner, double &value)
+{
+    const char *p = scanner.cursor;
+    while (p < scanner.end && is_space(*p))
+        p++;
+    bool negative = p < scanner.end && *p == '-';
+    if (p < scanner.end && (*p == '-' || *p == '+'))
+        p++;
+    double result = 0;
+    bool digits = false;
+    while (p < scanner.end && *p >= '0' && *p <= '9')
+    {
+        result = result * 10 + (*p++ - '0');
+        digits = true;
+    }
+    if (p < scanner.end && *p == '.')
+    {
+        p++;
+        double scale = 0.1;
+        while (p < scanner.end && *p >= '0' && *p <= '9')
+        {
+            result += (*p++ - '0') * scale;
+            scale *= 0.1;
+            digits = true;
+        }
+    }
+    if (!digits)
+        return false;
+    if (p < scanner.end && (*p == 'e' || *p == 'E'))
+    {
+        TsplibScanner exponent_scanner = {p + 1, scanner.end};
+        long long exponent;
+        if (scan_int(exponent_scanner, exponent))
+        {
+            result *= std::pow(10.0, (double)exponent);
+            p = exponent_scanner.cursor;
+        }
+    }
+    scanner.cursor = p;
+    value = negative ? -result : result;
+    return true;
+}
+
+// Splits "KEY : VALUE" (spaces around the colon optional); false if there is no colon
+bool split_header(const char *begin, const char *finish, std::string &key, std::string &value)
+{
+    const char *colon = static_cast<const char *>(memchr(begin, ':', finish - begin));
+    if (colon == nullptr)
+        return false;
+    const char *key_end = colon;
+    while (key_end > begin && is_space(key_end[-1]))
+        key_end--;
+    const char *value_begin = colon + 1;
+    while (value_begin < finish && is_space(*value_begin))
+        value_begin++;
+    key.assign(begin, key_end);
+    value.assign(value_begin, finish);
+    return true;
+}
+
+inline int nint(double x)
+{
+    return (int)(x + 0.5);
+}
+
+// TSPLIB geographical coordinates: DDD.MM, degrees and minutes
+double geo_radians(double x)
+{
+    const double PI = 3.141592;
+    int degrees = (int)x;
+    double minutes = x - degrees;
+    return PI * (degrees + 5.0 * minutes / 3.0) / 180.0;
+}
+
+int coordinate_distance(TsplibWeightType type, double xi, double yi, double xj, double yj)
+{
+    double dx = xi - xj, dy = yi - yj;
+    switch (type)
+    {
+    case WEIGHT_CEIL_2D:
+        return (int)std::ceil(std::sqrt(dx * dx + dy * dy));
+    case WEIGHT_ATT:
+    {
+        double r = std::sqrt((dx * dx + dy * dy) / 10.0);
+        int t = nint(r);
+        return t < r ? t + 1 : t;
+    }
+    case WEIGHT_GEO:
+    {
+        const double RRR = 6378.388;
+        double lat_i = geo_radians(xi), lon_i = geo_radians(yi);
+        double lat_j = geo_radians(xj), lon_j = geo_radians(yj);
+        double q1 = std::cos(lon_i - lon_j);
+        double q2 = std::cos(lat_i - lat_j);
+        double q3 = std::cos(lat_i + lat_j);
+        return (int)(RRR * std::acos(0.5 * ((1.0 + q1) * q2 - (1.0 - q1) * q3)) + 1.0);
+    }
+    default:
+        return nint(std::sqrt(dx * dx + dy * dy));
+    }
+}
+
+bool parse_weight_type(const std::string &value, TsplibWeightType &type)
+{
+    if (value == "EXPLICIT")
+        type = WEIGHT_EXPLICIT;
+    else if (value == "EUC_2D")
+        type = WEIGHT_EUC_2D;
+    else if (value == "CEIL_2D")
+        type = WEIGHT_CEIL_2D;
+    else if (value == "GEO")
+        type = WEIGHT_GEO;
+    else if (value == "ATT")
+        type = WEIGHT_ATT;
+    else
+        return false;
+    return true;
+}
+
+// Column-wise formats list the transposed triangle, which is the other row-wise one
+bool parse_weight_format(const std::string &value, TsplibWeightFormat &format)
+{
+    if (value == "FULL_MATRIX")
+        format = FORMAT_FULL_MATRIX;
+    else if (value == "UPPER_ROW" || value == "LOWER_COL")
+        format = FORMAT_UPPER_ROW;
+    else if (value == "LOWER_ROW" || value == "UPPER_COL")
+        format = FORMAT_LOWER_ROW;
+    else if (value == "UPPER_DIAG_ROW" || value == "LOWER_DIAG_COL")
+        format = FORMAT_UPPER_DIAG_ROW;
+    else if (value == "LOWER_DIAG_ROW" || value == "UPPER_DIAG_COL")
+        format = FORMAT_LOWER_DIAG_ROW;
+    else
+        return false;
+    return true;
+}
+
+// Numbers listed by an EDGE_WEIGHT_SECTION of n cities
+unsigned long long edge_weight_count(TsplibWeightFormat format, int n)
+{
+    unsigned long long cities = n;
+    switch (format)
+    {
+    case FORMAT_UPPER_ROW:
+    case FORMAT_LOWER_ROW:
+        return cities * (cities - 1) / 2;
+    case FORMAT_UPPER_DIAG_ROW:
+    case FORMAT_LOWER_DIAG_ROW:
+        return cities * (cities + 1) / 2;
+    default:
+        return cities * cities;
+    }
+}
+
+bool read_edge_weights(TsplibScanner &scanner, TsplibWeightFormat format, int n, std::vector<int> &distances)
+{
+    for (int i = 0; i < n; i++)
+    {
+        int from = 0, to = n; // Columns of row i present in the file
+        switch (format)
+        {
+        case FORMAT_UPPER_ROW:
+            from = i + 1;
+            break;
+        case FORMAT_LOWER_ROW:
+            to = i;
+            break;
+        case FORMAT_UPPER_DIAG_ROW:
+            from = i;
+            break;
+        case FORMAT_LOWER_DIAG_ROW:
+            to = i + 1;
+            break;
+        default:
+            break;
+        }
+        for (int j = from; j < to; j++)
+        {
+            long long weight;
+            if (!scan_int(scanner, weight))
+                return false;
+            distances[(size_t)i * n + j] = (int)weight;
+            if (format != FORMAT_FULL_MATRIX)
+                distances[(size_t)j * n + i] = (int)weight;
+        }
+    }
+    return true;
+}
+
+// A loaded instance. Coordinate instances may keep just their coordinates and have
+// distances computed on demand by instance_distance(); explicit ones always carry
+// the full matrix.
+struct TspInstance
+{
+    int num_cities = 0;
+    TsplibWeightType type = WEIGHT_EXPLICIT;
+    std::vector<double> x, y;
+    std::vector<int> distances; // n x n; empty when only the coordinates are kept
+};
+
+inline int instance_distance(const TspInstance &instance, int i, int j)
+{
+    if (!instance.distances.empty())
+        return instance.distances[(size_t)i * instance.num_cities + j];
+    return i == j ? 0 : coordinate_distance(instance.type, instance.x[i], instance.y[i], instance.x[j], instance.y[j]);
+}
+
+bool read_coordinates(TsplibScanner &scanner, int n, std::vector<double> &x, std::vector<double> &y)
+{
+    x.assign(n, 0.0);
+    y.assign(n, 0.0);
+    for (int k = 0; k < n; k++)
+    {
+        long long id;
+        double xk, yk;
+        if (!scan_int(scanner, id) || !scan_double(scanner, xk) || !scan_double(scanner, yk) || id < 1 || id > n)
+            return false;
+        x[id - 1] = xk;
+        y[id - 1] = yk;
+    }
+    return true;
+}
+
+void fill_coordinate_matrix(const TspInstance &instance, std::vector<int> &distances)
+{
+    const int n = instance.num_cities;
+    distances.assign((size_t)n * n, 0);
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int i = 0; i < n; i++)
+    {
+        int *row = &distances[(size_t)i * n];
+        for (int j = 0; j < n; j++)
+        {
+            row[j] = i == j ? 0
+                            : coordinate_distance(instance.type, instance.x[i], instance.y[i], instance.x[j], instance.y[j]);
+        }
+    }
+}
+
+// Lets the loader refuse a city count before allocating for it; prints its own error
+typedef bool (*CitiesSupportedFn)(int num_cities);
+
+// Loads an instance and returns its number of cities, or 0 on error. Coordinates are
+// turned into the full matrix unless `keep_coordinates` is set. If `supported` is
+// given, a city count it rejects fails the load before anything is allocated.
+int read_tsplib_instance(const std::string &filename, TspInstance &instance, bool keep_coordinates,
+                         CitiesSupportedFn supported = nullptr)
+{
+    MappedFile file;
+    if (!map_file(filename, file))
+    {
+        std::cerr << "Error: Unable to open file." << std::endl;
+        return 0;
+    }
+
+    TsplibScanner scanner = {file.data, file.data + file.size};
+    int num_cities = 0;
+    TsplibWeightType &type = instance.type;
+    type = WEIGHT_EXPLICIT;
+    TsplibWeightFormat format = FORMAT_LOWER_DIAG_ROW; // What the bundled instances use
+    bool loaded = false;
+    bool rejected = false; // By `supported`, which already printed why
+    std::string error;
+
+    const char *begin, *finish;
+    std::string key, value;
+    while (error.empty() && !loaded && scan_line(scanner, begin, finish))
+    {
+        std::string section(begin, finish);
+        if (section == "EDGE_WEIGHT_SECTION" || section == "NODE_COORD_SECTION")
+        {
+            if (num_cities <= 0)
+            {
+                error = "DIMENSION missing before " + section;
+                break;
+            }
+            bool explicit_weights = section == "EDGE_WEIGHT_SECTION";
+            if (supported != nullptr && !supported(num_cities))
+            {
+                rejected = true;
+                break;
+            }
+            // Every number takes a digit and a separator, so a DIMENSION the rest of the
+            // file cannot hold is refused before its matrix or coordinates are allocated
+            unsigned long long numbers = explicit_weights ? edge_weight_count(format, num_cities) : 3ULL * num_cities;
+            if (2 * numbers > (unsigned long long)(scanner.end - scanner.cursor) + 1)
+            {
+                error = section + " is too short for DIMENSION " + std::to_string(num_cities);
+                break;
+            }
+            instance.num_cities = num_cities;
+            if (explicit_weights)
+                instance.distances.assign((size_t)num_cities * num_cities, 0);
+            else
+                instance.distances.clear(); // Left over from an earlier instance
+            if (explicit_weights != (type == WEIGHT_EXPLICIT))
+                error = section + " does not match EDGE_WEIGHT_TYPE";
+            else if (explicit_weights ? !read_edge_weights(scanner, format, num_cities, instance.distances)
+                                      : !read_coordinates(scanner, num_cities, instance.x, instance.y))
+                error = "Truncated or malformed " + section;
+            else
+                loaded = true;
+            if (loaded && !explicit_weights && !keep_coordinates)
+                fill_coordinate_matrix(instance, instance.distances);
+        }
+        else if (section == "EOF")
+        {
+            break;
+        }
+        else if (split_header(begin, finish, key, value))
+        {
+            if (key == "DIMENSION")
+            {
+                char *end;
+                long dimension = strtol(value.c_str(), &end, 10);
+                if (end == value.c_str() || *end != '\0' || dimension < 1 || dimension > INT_MAX)
+                    error = "Invalid DIMENSION " + value;
+                else
+                    num_cities = (int)dimension;
+            }
+            else if (key == "EDGE_WEIGHT_TYPE" && !parse_weight_type(value, type))
+                error = "Unsupported EDGE_WEIGHT_TYPE " + value;
+            else if (key == "EDGE_WEIGHT_FORMAT" && !parse_weight_format(value, format))
+                error = "Unsupported EDGE_WEIGHT_FORMAT " + value;
+        }
+    }
+    unmap_file(file);
+
+    if (error.empty() && !loaded && !rejected)
+        error = "No EDGE_WEIGHT_SECTION or NODE_COORD_SECTION";
+    if (!error.empty() || rejected)
+    {
+        if (!error.empty())
+            std::cerr << "Error: " << error << " in " << filename << "." << std::endl;
+        instance = TspInstance();
+        return 0;
+    }
+    return num_cities;
+}
+
+// Fills `distances` with the full n x n matrix and returns n, or 0 on error
+int read_tsplib_matrix(const std::string &filename, std::vector<int> &distances, CitiesSupportedFn supported = nullptr)
+{
+    TspInstance instance;
+    int num_cities = read_tsplib_instance(filename, instance, false, supported);
+    distances.swap(instance.distances);
+    return num_cities;
+}
@@ -1,12 +1,8 @@
+#include <algorithm>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
 #include <vector>
 
-const int INITIAL_SYNC_PERIOD = 100;     // Start by syncing every 10 paths
-const int MAX_SYNC_PERIOD = 1000;        // Never wait more than 1000 paths before syncing
-const double SYNC_INCREASE_FACTOR = 1.5; // Increase sync period by 50% each time
-
 void create_paths(std::vector<std::vector<int>> &paths, int start, int num_cities)
 {
     for (int i = 0; i < num_cities; i++)
@@ -55,14 +51,15 @@ void dfs(
     int &min_distance,
     std::vector<int> &min_path,
     std::vector<int> &distances,
-    int num_cities)
+    int num_cities,
+    LowerBound &bound)
 {
 
     // Base case: all cities have been visited
     if ((int)path.size() == num_cities)
     {
         // Add the distance from the last city back to the starting city
-        int dist = curr_distance + get_distance(path[path.size() - 1], path.back(), distances, num_cities);
+        int dist = curr_distance + get_distance(path.back(), path[0], distances, num_cities);
         if (dist < min_distance)
         {
             min_distance = dist;
@@ -85,9 +82,19 @@ void dfs(
                 continue;
             }
             visited[i] = true;
+            bound_visit(bound, i);
+            // Prune if even the cheapest possible completion cannot beat the minimum distance
+            if (curr_distance + bound_remaining(bound, visited, i, distances, min_distance - curr_distance) >= min_distance)
+            {
+                bound_unvisit(bound, i);
+                visited[i] = false;
+                curr_distance = prev_distance;
+                continue;
+            }
             path.push_back(i);
-            dfs(path, visited, curr_distance, min_distance, min_path, distances, num_cities);
+            dfs(path, visited, curr_distance, min_distance, min_path, distances, num_cities, bound);
             path.pop_back();
+            bound_unvisit(bound, i);
             visited[i] = false;
             curr_distance = prev_distance;
         }
@@ -135,88 +142,49 @@ std::pair<std::vector<int>, int> nearest_neighbor_tsp(std::vector<int> &distance
     return {path, total_distance};
 }
 
-int read_file(const std::string &filename, std::vector<int> &distances)
+// Row i lists the other cities by increasing distance from i (n entries per row,
+// the last one unused), so searches can try the closest cities first
+void build_neighbor_lists(const std::vector<int> &distances, int num_cities, std::vector<int> &neighbors)
 {
-    int num_cities;
-    std::ifstream infile(filename);
-
-    if (!infile.is_open())
-    {
-        std::cerr << "Error: Unable to open file." << std::endl;
-        return 0;
-    }
-    infile >> num_cities;
-
-    distances.resize(num_cities * num_cities);
+    neighbors.assign((size_t)num_cities * num_cities, 0);
     for (int i = 0; i < num_cities; i++)
     {
-        for (int j = 0; j < i; j++)
+        int *row = &neighbors[(size_t)i * num_cities];
+        int count = 0;
+        for (int j = 0; j < num_cities; j++)
         {
-            int distance;
-            infile >> distance;
-            distances[i * num_cities + j] = distance;
-            distances[j * num_cities + i] = distance;
+            if (j != i)
+                row[count++] = j;
         }
+        const int *from = &distances[(size_t)i * num_cities];
+        std::stable_sort(row, row + count, [from](int a, int b) { return from[a] < from[b]; });
     }
-
-    infile.close();
-    return num_cities;
 }
 
-int read_tsplib_matrix(const std::string &filename, std::vector<int> &distances)
+int read_file(const std::string &filename, std::vector<int> &distances)
 {
+    int num_cities;
     std::ifstream infile(filename);
+
     if (!infile.is_open())
     {
         std::cerr << "Error: Unable to open file." << std::endl;
         return 0;
     }
+    infile >> num_cities;
 
-    std::string line;
-    int num_cities = 0;
-
-    // Parse the file header to get the number of cities (DIMENSION)
-    while (std::getline(infile, line))
-    {
-        if (line.substr(0, 9) == "DIMENSION")
-        {
-            num_cities = std::stoi(line.substr(11));
-        }
-        else if (line == "EDGE_WEIGHT_SECTION")
-        {
-            break;
-        }
-    }
-
-    distances.resize(num_cities * num_cities, 0);
-
-    // Read the lower diagonal row of the distance matrix
+    distances.resize(num_cities * num_cities);
     for (int i = 0; i < num_cities; i++)
     {
-        for (int j = 0; j <= i; j++)
+        for (int j = 0; j < i; j++)
         {
             int distance;
             infile >> distance;
             distances[i * num_cities + j] = distance;
-            distances[j * num_cities + i] = distance; // Symmetric TSP
+            distances[j * num_cities + i] = distance;
         }
     }
 
     infile.close();
     return num_cities;
 }
-
-void log_event(
-    const std::string &filename,
-    const std::string &action,
-    const std::string &hostname,
-    int current_thread_id,
-    double start_time,
-    double end_time)
-{
-    std::ofstream log_file;
-    log_file.open(filename, std::ios_base::app);
-    log_file << std::fixed << std::setprecision(8);
-    log_file << action << "," << hostname << "," << current_thread_id << "," << start_time << "," << end_time << std::endl;
-    log_file.close();
-}
\ No newline at end of file
@@ -1,2 +1,18 @@
 #pragma once
-#include "utils.cpp"
\ No newline at end of file
+#include "distance_matrix.cpp"
+#include "bounds.cpp"
+#include "incumbent.cpp"
+#include "trace.cpp"
+#include "utils.cpp"
+#include "tsplib.cpp"
+#include "held_karp.cpp"
+#include "memo.cpp"
+#include "prefixes.cpp"
+#include "checkpoint.cpp"
+#include "anytime.cpp"
+#include "lin_kernighan.cpp"
+#include "heuristics.cpp"
+#include "kernel.cpp"
+#include "stats.cpp"
+#include "options.cpp"
+#include "batch.cpp"
\ No newline at end of file